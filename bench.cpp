@@ -0,0 +1,201 @@
+#include "graph/graph.h"
+#include "graph/versionedGraph.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#define SEED 2024
+#define MIN_SECONDS 0.2 // Each benchmark repeats until it ran at least this long
+#define MIN_RUNS 3
+#define QUERIES 100000 // Calls timed together for the per node operations
+#define BENCH_FILE "bench_graph.gc"
+
+/**
+ * Times every Graph operator on seeded graphs of several shapes and sizes.
+ * Prints one comma separated line per benchmark, in a fixed order, so the output of two builds can be diffed:
+ *     benchmark, shape, nodes, edges, runs, ns per operation, edges per second, peak RSS in KB
+ * A benchmark runs only if its name contains the first argument, when there is one.
+ */
+
+static std::string name(uint64_t i) {
+    return "n" + std::to_string(i);
+}
+
+/**
+ * Random graph with edges picked uniformly from all pairs of distinct nodes
+ */
+static Graph uniform(unsigned nodes, uint64_t edges, uint64_t seed) {
+    std::mt19937_64 random(seed);
+    std::uniform_int_distribution<unsigned> node(0, nodes - 1);
+    std::unordered_set<uint64_t> added; // Edges are counted here, the graph's own count would merge them every time
+    Graph g;
+    for(unsigned i = 0; i < nodes; i++) {
+        g.addNode(name(i));
+    }
+    while(added.size() < edges) {
+        unsigned u = node(random), v = node(random);
+        if(u != v && added.insert((uint64_t) u << 32 | v).second) {
+            g.addEdge(name(u), name(v));
+        }
+    }
+    return g;
+}
+
+/**
+ * Preferential attachment: every new node links to a few earlier nodes, picked in proportion to their degree
+ */
+static Graph powerLaw(unsigned nodes, unsigned links, uint64_t seed) {
+    std::mt19937_64 random(seed);
+    std::vector<unsigned> ends; // Every node once per edge it's on
+    std::unordered_set<uint64_t> added;
+    Graph g;
+    for(unsigned i = 0; i <= links; i++) {
+        g.addNode(name(i));
+        for(unsigned j = 0; j < i; j++) {
+            g.addEdge(name(i), name(j));
+            added.insert((uint64_t) i << 32 | j);
+            ends.push_back(i);
+            ends.push_back(j);
+        }
+    }
+    for(unsigned i = links + 1; i < nodes; i++) {
+        g.addNode(name(i));
+        for(unsigned j = 0; j < links; j++) {
+            unsigned target = ends[std::uniform_int_distribution<size_t>(0, ends.size() - 1)(random)];
+            if(target != i && added.insert((uint64_t) i << 32 | target).second) {
+                g.addEdge(name(i), name(target));
+                ends.push_back(i);
+                ends.push_back(target);
+            }
+        }
+    }
+    return g;
+}
+
+struct Shape {
+    std::string label;
+    unsigned nodes;
+    std::function<Graph(uint64_t seed)> make;
+};
+
+static long peakKilobytes() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+/**
+ * Runs f until it took long enough to measure and prints the result line
+ * @param items How many calls f makes to the operation
+ * @param edges The edges each call processes
+ */
+static void measure(const std::string& filter, const std::string& benchmark, const Shape& shape, const Graph& g,
+                    uint64_t items, uint64_t edges, const std::function<void()>& f) {
+    if(benchmark.find(filter) == std::string::npos) {
+        return;
+    }
+    typedef std::chrono::steady_clock Clock;
+    unsigned runs = 0;
+    double seconds = 0;
+    Clock::time_point start = Clock::now();
+    while(runs < MIN_RUNS || seconds < MIN_SECONDS) {
+        f();
+        runs++;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    double operations = (double) runs * items;
+    std::printf("%s,%s,%zu,%llu,%u,%.1f,%.0f,%ld\n", benchmark.c_str(), shape.label.c_str(), g.getNodes().size(),
+                (unsigned long long) g.edgeCount(), runs, seconds * 1e9 / operations,
+                edges * operations / seconds, peakKilobytes());
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    std::vector<Shape> shapes;
+    for(unsigned nodes : {1000u, 16000u, 128000u}) {
+        shapes.push_back({"sparse", nodes, [nodes](uint64_t seed){return uniform(nodes, 2ULL * nodes, seed);}});
+        shapes.push_back({"random", nodes, [nodes](uint64_t seed){return uniform(nodes, 8ULL * nodes, seed);}});
+        shapes.push_back({"powerlaw", nodes, [nodes](uint64_t seed){return powerLaw(nodes, 4, seed);}});
+    }
+    for(unsigned nodes : {256u, 1024u}) {
+        shapes.push_back({"dense", nodes, [nodes](uint64_t seed){return uniform(nodes, (uint64_t) nodes * nodes / 2, seed);}});
+    }
+
+    std::printf("benchmark,shape,nodes,edges,runs,ns_per_op,edges_per_sec,peak_rss_kb\n");
+    for(const Shape& shape : shapes) {
+        const Graph g1 = shape.make(SEED), g2 = shape.make(SEED + 1);
+        uint64_t both = g1.edgeCount() + g2.edgeCount();
+        measure(filter, "unite", shape, g1, 1, both, [&](){Graph::unite(g1, g2);});
+        measure(filter, "intersection", shape, g1, 1, both, [&](){Graph::intersection(g1, g2);});
+        measure(filter, "difference", shape, g1, 1, both, [&](){Graph::difference(g1, g2);});
+        if(g1.edgeCount() * g2.edgeCount() <= (1ULL << 24)) {
+            measure(filter, "product", shape, g1, 1, both, [&](){Graph::product(g1, g2);});
+        }
+        if(shape.nodes <= 4096) {
+            measure(filter, "complement", shape, g1, 1, g1.edgeCount(), [&](){g1.complement();});
+        }
+
+        std::vector<std::string> queries;
+        std::mt19937_64 random(SEED);
+        std::uniform_int_distribution<unsigned> node(0, shape.nodes - 1);
+        for(unsigned i = 0; i < QUERIES; i++) {
+            queries.push_back(name(node(random)));
+        }
+        uint64_t found = 0;
+        for(const std::string& n : queries) {
+            found += g1.neighbours(n).size();
+        }
+        measure(filter, "neighbours", shape, g1, QUERIES, found / QUERIES, [&](){
+            for(const std::string& n : queries) {
+                g1.neighbours(n);
+            }
+        });
+        measure(filter, "adjacent", shape, g1, QUERIES, 1, [&](){
+            for(unsigned i = 0; i + 1 < queries.size(); i++) {
+                g1.adjacent(queries[i], queries[i + 1]);
+            }
+        });
+
+        // Every hardware thread runs all the queries on snapshots it pins, so the time stays flat if reads scale
+        VersionedGraph versions(g1);
+        unsigned readers = std::max(1u, std::thread::hardware_concurrency());
+        measure(filter, "pinned_adjacent", shape, g1, QUERIES, 1, [&](){
+            std::vector<std::thread> threads;
+            for(unsigned t = 0; t < readers; t++) {
+                threads.emplace_back([&]() {
+                    for(unsigned i = 0; i + 1 < queries.size(); i++) {
+                        versions.pin()->adjacent(queries[i], queries[i + 1]);
+                    }
+                });
+            }
+            for(std::thread& thread : threads) {
+                thread.join();
+            }
+        });
+
+        measure(filter, "save", shape, g1, 1, g1.edgeCount(), [&](){g1.save(BENCH_FILE);});
+        // Loading only maps the file and checks it, the edges are read once they are used
+        g1.save(BENCH_FILE); // Also when the save benchmark is filtered out
+        measure(filter, "map", shape, g1, 1, g1.edgeCount(), [&](){Graph::load(BENCH_FILE).edgeCount();});
+        measure(filter, "load", shape, g1, 1, g1.edgeCount(), [&](){
+            Graph loaded = Graph::load(BENCH_FILE);
+            loaded.settle();
+            loaded.edges();
+        });
+        std::remove(BENCH_FILE);
+        measure(filter, "print", shape, g1, 1, g1.edgeCount(), [&](){
+            std::ostringstream out;
+            out << g1;
+        });
+    }
+    return 0;
+}
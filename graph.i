@@ -1,4 +1,4 @@
-%module wrappers
+%module(threads="1") wrappers
 
 %{
 #include "swig/wrappers.h"
@@ -6,12 +6,51 @@
 %}
 
 %include "std_string.i"
+%include "std_vector.i"
+%include "std_pair.i"
 
+%template(StringVector) std::vector<std::string>;
+%template(StringPair) std::pair<std::string, std::string>;
+%template(EdgeVector) std::vector<std::pair<std::string, std::string> >;
+
+// Any bytes-like object, read in place. The buffer stays exported until the call returns, since it is read without
+// the GIL, and an exported bytearray can't be resized meanwhile.
+%typemap(in) (const char* text, size_t length) (Py_buffer view, bool viewed = false) {
+    if(PyObject_GetBuffer($input, &view, PyBUF_SIMPLE) != 0) {
+        SWIG_fail;
+    }
+    viewed = true;
+    $1 = ($1_ltype) view.buf;
+    $2 = ($2_ltype) view.len;
+}
+%typemap(freearg) (const char* text, size_t length) {
+    if(viewed$argnum) {
+        PyBuffer_Release(&view$argnum);
+    }
+}
+
+// Whole graphs go to Python as one bytes object, not a list of a string or two per node or edge
+%typemap(out) std::string vertexBytes, std::string edgeBytes {
+    $result = PyBytes_FromStringAndSize($1.data(), $1.size());
+}
+
+// Single node and edge calls are too short to be worth releasing the GIL
+%nothread;
 Graph* create();
 void destroy(Graph*);
 Graph* addVertex(Graph*, const std::string&);
 Graph* addEdge(Graph*, const std::string&, const std::string&);
 void disp(Graph*);
+
+// Every call takes the locks of the graphs it uses, see swig/wrappers.cpp, so releasing the GIL is safe
+%thread;
+Graph* addVertices(Graph*, const std::vector<std::string>&);
+Graph* addEdges(Graph*, const std::vector<std::pair<std::string, std::string> >&);
+Graph* addEdgeList(Graph*, const char* text, size_t length);
+std::vector<std::string> vertices(Graph*);
+std::vector<std::pair<std::string, std::string> > edges(Graph*);
+std::string vertexBytes(Graph*);
+std::string edgeBytes(Graph*);
 Graph* graphUnion(Graph*, Graph*, Graph*);
 Graph* graphIntersection(Graph*, Graph*, Graph*);
 Graph* graphDifference(Graph*, Graph*, Graph*);
@@ -0,0 +1,242 @@
+#include "adjacency.h"
+#include "graphFile.h"
+#include "threadPool.h"
+#include <algorithm>
+
+static const uint64_t emptyOffsets[1] = {0};
+
+Adjacency::Adjacency() : offsets(Buffer<uint64_t>::unowned(emptyOffsets, 1)), degrees(), targets(), edgeCount(0) {}
+
+Adjacency::Adjacency(NodeId rows) : offsets(rows + 1, 0), degrees(rows, 0), targets(), edgeCount(0) {}
+
+/**
+ * Builds the rows from edge keys that are sorted and free of duplicates
+ */
+Adjacency::Adjacency(NodeId rows, const std::vector<EdgeKey>& sortedKeys) : Adjacency(rows) {
+    targets.reserve(sortedKeys.size());
+    for(EdgeKey key : sortedKeys) {
+        degrees[keySrc(key)]++;
+        targets.push_back(keyDest(key));
+    }
+    for(NodeId u = 0; u < rows; u++) {
+        offsets[u + 1] = offsets[u] + degrees[u];
+    }
+    edgeCount = sortedKeys.size();
+}
+
+/**
+ * Builds the rows from runs of sorted keys, where every run's sources come after the previous run's.
+ * Runs are copied into place in parallel.
+ */
+Adjacency::Adjacency(NodeId rows, const std::vector<std::vector<EdgeKey>>& sortedRuns) : Adjacency(rows) {
+    std::vector<uint64_t> starts(sortedRuns.size() + 1, 0); // Where each run's targets go
+    for(size_t i = 0; i < sortedRuns.size(); i++) {
+        starts[i + 1] = starts[i] + sortedRuns[i].size();
+    }
+    uint32_t* degreeData = degrees.data();
+    targets.resize(starts.back());
+    NodeId* targetData = targets.data();
+    ThreadPool::parallelFor(sortedRuns.size(), [&starts](size_t i){return starts[i];}, [&](unsigned, size_t first, size_t last) {
+        for(size_t i = first; i < last; i++) {
+            NodeId* out = targetData + starts[i];
+            for(EdgeKey key : sortedRuns[i]) {
+                degreeData[keySrc(key)]++;
+                *out++ = keyDest(key);
+            }
+        }
+    });
+    for(NodeId u = 0; u < rows; u++) {
+        offsets[u + 1] = offsets[u] + degrees[u];
+    }
+    edgeCount = starts.back();
+}
+
+/**
+ * Reads the rows in place from a graph file. Only the sizes of the arrays are checked, so loading stays O(1);
+ * check() walks the rows themselves.
+ */
+Adjacency::Adjacency(GraphReader& reader) : offsets(reader.read<uint64_t>()), degrees(reader.read<uint32_t>()),
+                                            targets(reader.read<NodeId>()), edgeCount(reader.value<uint64_t>()) {
+    reader.check(offsets.size() == degrees.size() + 1 && degrees.size() < SymbolTable::NONE && offsets[0] == 0 &&
+                 offsets.back() <= targets.size());
+}
+
+/**
+ * Checks rows read from a graph file in one pass split between threads: every row lies within the targets and holds
+ * increasing targets that are other rows
+ */
+void Adjacency::check(const GraphReader& reader) const {
+    uint64_t edges = 0;
+    for(NodeId u = 0; u < rows(); u++) {
+        reader.check(offsets[u] <= offsets[u + 1] && degrees[u] <= offsets[u + 1] - offsets[u]);
+        edges += degrees[u];
+    }
+    reader.check(edges == edgeCount);
+    ThreadPool::parallelFor(rows(), [this](size_t u){return offsets[u];}, [&](unsigned, size_t first, size_t last) {
+        for(NodeId u = first; u < last; u++) {
+            for(const NodeId* v = begin(u); v != end(u); v++) {
+                reader.check(*v < rows() && *v != u && (v == begin(u) || v[-1] < *v));
+            }
+        }
+    });
+}
+
+bool Adjacency::contains(NodeId u, NodeId v) const {
+    return u < rows() && std::binary_search(begin(u), end(u), v);
+}
+
+bool Adjacency::erase(NodeId u, NodeId v) {
+    if(u >= rows()) {
+        return false;
+    }
+    NodeId* first = targets.data() + offsets[u];
+    NodeId* last = first + degrees[u];
+    NodeId* position = std::lower_bound(first, last, v);
+    if(position == last || *position != v) {
+        return false;
+    }
+    std::copy(position + 1, last, position);
+    degrees[u]--;
+    edgeCount--;
+    return true;
+}
+
+void Adjacency::clearRow(NodeId u) {
+    edgeCount -= degrees[u];
+    degrees[u] = 0;
+}
+
+void Adjacency::resize(NodeId rows) {
+    offsets.resize(rows + 1, offsets.back());
+    degrees.resize(rows, 0);
+}
+
+void Adjacency::clear() {
+    offsets.assign(offsets.size(), 0);
+    degrees.assign(degrees.size(), 0);
+    targets.clear();
+    edgeCount = 0;
+}
+
+void Adjacency::compact() {
+    offsets.compact();
+    degrees.compact();
+    targets.compact();
+}
+
+/**
+ * Sorts keys and drops duplicates. Large inputs are sorted in slices on every thread, then the slices are merged
+ * pairwise, also in parallel.
+ */
+static void sortKeys(std::vector<EdgeKey>& keys) {
+    std::vector<size_t> bounds(ThreadPool::threads() + 1, 0);
+    unsigned parts = ThreadPool::parallelFor(keys.size(), [](size_t i){return (uint64_t) i;}, [&](unsigned part, size_t first, size_t last) {
+        std::sort(keys.begin() + first, keys.begin() + last);
+        bounds[part + 1] = last;
+    });
+    bounds.resize(parts + 1);
+    while(bounds.size() > 2) {
+        std::vector<size_t> merged(1, 0);
+        std::vector<std::future<void>> merges;
+        for(size_t i = 0; i + 2 < bounds.size(); i += 2) {
+            auto first = keys.begin() + bounds[i], middle = keys.begin() + bounds[i + 1], last = keys.begin() + bounds[i + 2];
+            merges.push_back(ThreadPool::shared().submit([first, middle, last](){std::inplace_merge(first, middle, last);}));
+            merged.push_back(bounds[i + 2]);
+        }
+        if(merged.back() != keys.size()) {
+            merged.push_back(keys.size());
+        }
+        for(std::future<void>& merge : merges) {
+            ThreadPool::shared().await(merge);
+        }
+        bounds.swap(merged);
+    }
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+/**
+ * Adds edges to the rows, dropping the ones that are already present.
+ * The rows are split between threads so that every part merges about as many old and new targets,
+ * which is the merge path split of the two sorted inputs taken at row boundaries.
+ * @param keys The edges to add, in any order. Sorted in place.
+ */
+void Adjacency::merge(std::vector<EdgeKey>& keys) {
+    if(keys.empty()) {
+        return;
+    }
+    sortKeys(keys);
+    if(keySrc(keys.back()) >= rows()) {
+        resize(keySrc(keys.back()) + 1);
+    }
+    auto firstKey = [&keys](size_t u) {
+        return std::lower_bound(keys.cbegin(), keys.cend(), edgeKey((NodeId) u, 0));
+    };
+    const Adjacency& self = *this;
+    std::vector<std::vector<EdgeKey>> runs(ThreadPool::threads());
+    auto cost = [&](size_t u){return self.offsets[u] + (firstKey(u) - keys.cbegin());};
+    ThreadPool::parallelFor(rows(), cost, [&](unsigned part, size_t first, size_t last) {
+        std::vector<EdgeKey>& run = runs[part];
+        run.reserve(self.offsets[last] - self.offsets[first] + (firstKey(last) - firstKey(first)));
+        auto key = firstKey(first);
+        for(NodeId u = first; u < last; u++) {
+            const NodeId* row = self.begin(u);
+            const NodeId* rowEnd = self.end(u);
+            while(key != keys.cend() && keySrc(*key) == u) {
+                NodeId v = keyDest(*key++);
+                while(row != rowEnd && *row < v) {
+                    run.push_back(edgeKey(u, *row++));
+                }
+                if(row == rowEnd || *row != v) {
+                    run.push_back(edgeKey(u, v));
+                }
+            }
+            while(row != rowEnd) {
+                run.push_back(edgeKey(u, *row++));
+            }
+        }
+    });
+    *this = Adjacency(rows(), runs);
+}
+
+/**
+ * Appends all edges as keys, in sorted order
+ */
+void Adjacency::appendTo(std::vector<EdgeKey>& keys) const {
+    keys.reserve(keys.size() + edgeCount);
+    for(NodeId u = 0; u < rows(); u++) {
+        for(const NodeId* v = begin(u); v != end(u); v++) {
+            keys.push_back(edgeKey(u, *v));
+        }
+    }
+}
+
+void Adjacency::save(GraphWriter& writer) const {
+    writer.add(offsets);
+    writer.add(degrees);
+    writer.add(targets);
+    writer.add(&edgeCount, 1);
+}
+
+/**
+ * @return The adjacency with every edge reversed. Sources are visited in order, so the rows come out sorted.
+ */
+Adjacency Adjacency::transposed() const {
+    Adjacency out(rows());
+    for(NodeId u = 0; u < rows(); u++) {
+        for(const NodeId* v = begin(u); v != end(u); v++) {
+            out.degrees[*v]++;
+        }
+    }
+    for(NodeId u = 0; u < rows(); u++) {
+        out.offsets[u + 1] = out.offsets[u] + out.degrees[u];
+    }
+    out.targets.resize(edgeCount);
+    std::vector<uint64_t> next(out.offsets.begin(), out.offsets.end() - 1);
+    for(NodeId u = 0; u < rows(); u++) {
+        for(const NodeId* v = begin(u); v != end(u); v++) {
+            out.targets[next[*v]++] = u;
+        }
+    }
+    out.edgeCount = edgeCount;
+    return out;
+}
@@ -0,0 +1,66 @@
+#ifndef GCALC_ADJACENCY_H
+#define GCALC_ADJACENCY_H
+#include "buffer.h"
+#include "symbolTable.h"
+#include <cstdint>
+#include <vector>
+
+typedef uint64_t EdgeKey;
+
+inline EdgeKey edgeKey(NodeId src, NodeId dest) {
+    return ((EdgeKey) src << 32) | dest;
+}
+
+inline NodeId keySrc(EdgeKey key) {
+    return (NodeId) (key >> 32);
+}
+
+inline NodeId keyDest(EdgeKey key) {
+    return (NodeId) key;
+}
+
+inline EdgeKey reversedKey(EdgeKey key) {
+    return edgeKey(keyDest(key), keySrc(key));
+}
+
+/**
+ * Compressed sparse row adjacency: the targets of every row are sorted and stored contiguously.
+ * A row may have more room than it uses, so erasing a target only shifts the rest of its own row.
+ * Additions are done in bulk with merge(), which rebuilds the arrays without the slack.
+ * Rows are independent, so bulk work is split between threads by ranges of rows.
+ */
+class Adjacency {
+    Buffer<uint64_t> offsets; // Row u may use targets[offsets[u], offsets[u + 1])
+    Buffer<uint32_t> degrees;
+    Buffer<NodeId> targets;
+    uint64_t edgeCount;
+
+public:
+    Adjacency();
+    explicit Adjacency(NodeId rows);
+    Adjacency(NodeId rows, const std::vector<EdgeKey>& sortedKeys);
+    Adjacency(NodeId rows, const std::vector<std::vector<EdgeKey>>& sortedRuns);
+    explicit Adjacency(GraphReader&);
+
+    NodeId rows() const {return (NodeId) degrees.size();}
+    uint64_t edges() const {return edgeCount;}
+    size_t bytes() const {return offsets.bytes() + degrees.bytes() + targets.bytes();}
+    uint32_t degree(NodeId u) const {return degrees[u];}
+    uint64_t offset(NodeId u) const {return offsets[u];}
+    const NodeId* begin(NodeId u) const {return targets.data() + offsets[u];}
+    const NodeId* end(NodeId u) const {return begin(u) + degrees[u];}
+
+    bool contains(NodeId, NodeId) const;
+    bool erase(NodeId, NodeId);
+    void clearRow(NodeId);
+    void resize(NodeId);
+    void clear();
+    void compact();
+    void merge(std::vector<EdgeKey>&);
+    void appendTo(std::vector<EdgeKey>&) const;
+    void check(const GraphReader&) const;
+    Adjacency transposed() const;
+    void save(GraphWriter&) const;
+};
+
+#endif //GCALC_ADJACENCY_H
@@ -0,0 +1,70 @@
+#ifndef GCALC_BUFFER_H
+#define GCALC_BUFFER_H
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Growable array that can also read its elements from memory it doesn't own, such as a mapped file.
+ * Borrowed elements are copied into the buffer's own storage the first time the buffer is modified,
+ * so a borrowed buffer can be copied and read without touching the elements.
+ */
+template<class T>
+class Buffer {
+    std::vector<T> owned;
+    std::shared_ptr<const void> keeper; // Keeps the borrowed memory alive, null while the elements are owned
+    const T* borrowed;
+    size_t borrowedSize;
+
+    void own() {
+        if(keeper) {
+            owned.assign(borrowed, borrowed + borrowedSize);
+            keeper.reset();
+        }
+    }
+
+public:
+    Buffer() : owned(), keeper(), borrowed(nullptr), borrowedSize(0) {}
+    Buffer(size_t n, const T& value) : owned(n, value), keeper(), borrowed(nullptr), borrowedSize(0) {}
+    Buffer(std::shared_ptr<const void> k, const T* elements, size_t n) : owned(), keeper(std::move(k)),
+                                                                          borrowed(elements), borrowedSize(n) {}
+
+    /**
+     * Reads elements with static storage, which need nothing to keep them alive, so nothing is allocated until the
+     * buffer is modified
+     */
+    static Buffer unowned(const T* elements, size_t n) noexcept {
+        return Buffer(std::shared_ptr<const void>(std::shared_ptr<const void>(), elements), elements, n);
+    }
+
+    size_t size() const {return keeper ? borrowedSize : owned.size();}
+    size_t bytes() const {return (keeper ? borrowedSize : owned.capacity()) * sizeof(T);}
+    bool empty() const {return size() == 0;}
+    const T* data() const {return keeper ? borrowed : owned.data();}
+    T* data() {own(); return owned.data();}
+    const T* begin() const {return data();}
+    const T* end() const {return data() + size();}
+    const T& back() const {return end()[-1];}
+    const T& operator[](size_t i) const {return data()[i];}
+    T& operator[](size_t i) {own(); return owned[i];}
+
+    void push_back(const T& value) {own(); owned.push_back(value);}
+    void append(const T* first, const T* last) {own(); owned.insert(owned.end(), first, last);}
+    void resize(size_t n, T value = T()) {own(); owned.resize(n, value);}
+    void reserve(size_t n) {own(); owned.reserve(n);}
+    void assign(size_t n, const T& value) {keeper.reset(); owned.assign(n, value);}
+    void clear() {keeper.reset(); owned.clear();}
+    void swap(std::vector<T>& other) {keeper.reset(); owned.swap(other);}
+
+    /**
+     * Frees the room the elements grew into but don't use, once it is more than an eighth of them
+     */
+    void compact() {
+        if(!keeper && owned.capacity() - owned.size() > owned.size() / 8) {
+            owned.shrink_to_fit();
+        }
+    }
+};
+
+#endif //GCALC_BUFFER_H
@@ -0,0 +1,157 @@
+#include "denseAdjacency.h"
+#include "threadPool.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AVX2_KERNELS
+#endif
+
+DenseAdjacency::DenseAdjacency() : DenseAdjacency(0) {}
+
+DenseAdjacency::DenseAdjacency(NodeId rows) : rowCount(rows), capacity(rows), stride((rows + 63) / 64),
+                                              bits((size_t) rows * stride, 0), edgeCount(0) {}
+
+bool DenseAdjacency::insert(NodeId u, NodeId v) {
+    uint64_t& word = row(u)[v / 64];
+    uint64_t mask = (uint64_t) 1 << (v % 64);
+    if(word & mask) {
+        return false;
+    }
+    word |= mask;
+    edgeCount++;
+    return true;
+}
+
+bool DenseAdjacency::erase(NodeId u, NodeId v) {
+    if(!contains(u, v)) {
+        return false;
+    }
+    row(u)[v / 64] &= ~((uint64_t) 1 << (v % 64));
+    edgeCount--;
+    return true;
+}
+
+void DenseAdjacency::clearRow(NodeId u) {
+    edgeCount -= count(row(u), words());
+    std::fill(row(u), row(u) + stride, 0);
+}
+
+void DenseAdjacency::clearColumn(NodeId v) {
+    for(NodeId u = 0; u < rowCount; u++) {
+        erase(u, v);
+    }
+}
+
+/**
+ * Grows the matrix. The capacity at least doubles, so adding nodes one by one stays linear on average.
+ */
+void DenseAdjacency::resize(NodeId rows) {
+    if(rows <= capacity) {
+        rowCount = std::max(rowCount, rows);
+        return;
+    }
+    NodeId newCapacity = std::max(rows, 2 * capacity);
+    size_t newStride = (newCapacity + 63) / 64;
+    std::vector<uint64_t> newBits((size_t) newCapacity * newStride, 0);
+    for(NodeId u = 0; u < rowCount; u++) {
+        std::copy(row(u), row(u) + stride, newBits.data() + u * newStride);
+    }
+    bits.swap(newBits);
+    capacity = newCapacity;
+    stride = newStride;
+    rowCount = rows;
+}
+
+void DenseAdjacency::recount() {
+    std::vector<uint64_t> counts(ThreadPool::threads(), 0);
+    size_t rowWords = words();
+    ThreadPool::parallelFor(rowCount, [rowWords](size_t u){return (uint64_t) u * rowWords;}, [&](unsigned part, size_t first, size_t last) {
+        for(size_t u = first; u < last; u++) {
+            counts[part] += count(row(u), rowWords);
+        }
+    });
+    edgeCount = 0;
+    for(uint64_t c : counts) {
+        edgeCount += c;
+    }
+}
+
+uint64_t DenseAdjacency::count(const uint64_t* a, size_t words) {
+    uint64_t total = 0;
+    for(size_t i = 0; i < words; i++) {
+        total += __builtin_popcountll(a[i]);
+    }
+    return total;
+}
+
+enum BitOp {UNITE, INTERSECT, SUBTRACT};
+
+typedef void (*Kernel)(uint64_t*, const uint64_t*, const uint64_t*, size_t);
+
+template<BitOp op>
+static inline uint64_t apply(uint64_t a, uint64_t b) {
+    return op == UNITE ? (a | b) : (op == INTERSECT ? (a & b) : (a & ~b));
+}
+
+template<BitOp op>
+static void scalarKernel(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words) {
+    for(size_t i = 0; i < words; i++) {
+        out[i] = apply<op>(a[i], b[i]);
+    }
+}
+
+#ifdef AVX2_KERNELS
+template<BitOp op>
+__attribute__((target("avx2")))
+static void avx2Kernel(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words) {
+    size_t i = 0;
+    for(; i + 4 <= words; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (a + i)), y = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i result = op == UNITE ? _mm256_or_si256(x, y) :
+                         (op == INTERSECT ? _mm256_and_si256(x, y) : _mm256_andnot_si256(y, x));
+        _mm256_storeu_si256((__m256i*) (out + i), result);
+    }
+    for(; i < words; i++) {
+        out[i] = apply<op>(a[i], b[i]);
+    }
+}
+#endif
+
+template<BitOp op>
+static Kernel pickKernel() {
+#ifdef AVX2_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return avx2Kernel<op>;
+    }
+#endif
+    return scalarKernel<op>;
+}
+
+template<BitOp op>
+static void runKernel(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words) {
+    static const Kernel kernel = pickKernel<op>(); // Picked once, on first use
+    kernel(out, a, b, words);
+}
+
+/**
+ * out = a | b, word by word. out may be a or b.
+ */
+void DenseAdjacency::unite(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words) {
+    runKernel<UNITE>(out, a, b, words);
+}
+
+/**
+ * out = a & b, word by word. out may be a or b.
+ */
+void DenseAdjacency::intersect(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words) {
+    runKernel<INTERSECT>(out, a, b, words);
+}
+
+/**
+ * out = a & ~b, word by word. out may be a or b.
+ */
+void DenseAdjacency::subtract(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words) {
+    runKernel<SUBTRACT>(out, a, b, words);
+}
@@ -0,0 +1,56 @@
+#ifndef GCALC_DENSEADJACENCY_H
+#define GCALC_DENSEADJACENCY_H
+#include "symbolTable.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * Adjacency matrix with one bit per pair of nodes, used for graphs where most pairs are connected.
+ * Rows are padded to a whole number of 64 bit words and every bit past the last row is kept clear,
+ * so whole rows can be combined with the word-wise kernels below.
+ */
+class DenseAdjacency {
+    NodeId rowCount;
+    NodeId capacity;
+    size_t stride; // Words between the starts of two rows
+    std::vector<uint64_t> bits;
+    uint64_t edgeCount;
+
+public:
+    DenseAdjacency();
+    explicit DenseAdjacency(NodeId rows);
+
+    NodeId rows() const {return rowCount;}
+    uint64_t edges() const {return edgeCount;}
+    size_t bytes() const {return bits.capacity() * sizeof(uint64_t);}
+    size_t words() const {return (rowCount + 63) / 64;}
+    const uint64_t* row(NodeId u) const {return bits.data() + u * stride;}
+    uint64_t* row(NodeId u) {return bits.data() + u * stride;}
+
+    bool contains(NodeId u, NodeId v) const {
+        return u < rowCount && v < rowCount && ((row(u)[v / 64] >> (v % 64)) & 1);
+    }
+    bool insert(NodeId, NodeId);
+    bool erase(NodeId, NodeId);
+    void clearRow(NodeId);
+    void clearColumn(NodeId);
+    void resize(NodeId);
+    void recount();
+
+    template<class F>
+    void forEach(NodeId u, F f) const {
+        const uint64_t* r = row(u);
+        for(size_t w = 0; w < words(); w++) {
+            for(uint64_t word = r[w]; word != 0; word &= word - 1) {
+                f((NodeId) (w * 64 + __builtin_ctzll(word)));
+            }
+        }
+    }
+
+    static void unite(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words);
+    static void intersect(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words);
+    static void subtract(uint64_t* out, const uint64_t* a, const uint64_t* b, size_t words);
+    static uint64_t count(const uint64_t* a, size_t words);
+};
+
+#endif //GCALC_DENSEADJACENCY_H
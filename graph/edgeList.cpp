@@ -0,0 +1,201 @@
+#include "edgeList.h"
+#include "graph.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <fstream>
+
+#define CHUNK_BYTES (4 << 20)
+#define CHUNKS_PER_THREAD 2 // Chunks waiting for each worker, so reading the file overlaps parsing it
+
+struct Chunk {
+    SymbolTable names; // The chunk's own ids, in the order the names first appear
+    std::vector<EdgeKey> edges;
+    uint64_t lines;
+};
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static NodeId internNode(SymbolTable& names, const char* str, size_t len) {
+    NodeId id = names.find(str, len);
+    if(id != SymbolTable::NONE) {
+        return id;
+    }
+    if(!Graph::validNode(str, len)) {
+        throw Graph::InvalidName(std::string(str, len));
+    }
+    return names.intern(str, len);
+}
+
+/**
+ * Parses whole lines. A line holds either a node, or the source and target of an edge separated by blanks.
+ * Empty lines and lines starting with '#' or '%' are skipped.
+ */
+static Chunk parseChunk(const char* line, const char* end) {
+    Chunk chunk;
+    chunk.lines = 0;
+    while(line < end) {
+        const char* lineEnd = (const char*) std::memchr(line, '\n', end - line);
+        lineEnd = lineEnd == nullptr ? end : lineEnd;
+        chunk.lines++;
+        const char* tokens[2];
+        size_t lengths[2];
+        int count = 0;
+        for(const char* c = line; c != lineEnd;) {
+            if(isBlank(*c)) {
+                c++;
+                continue;
+            }
+            if(count == 0 && (*c == '#' || *c == '%')) {
+                break;
+            }
+            const char* start = c;
+            while(c != lineEnd && !isBlank(*c)) {
+                c++;
+            }
+            if(count == 2) {
+                throw Graph::Edge::EdgeError("'" + std::string(line, lineEnd) + "' is not a valid edge!");
+            }
+            tokens[count] = start;
+            lengths[count++] = c - start;
+        }
+        if(count > 0) {
+            NodeId src = internNode(chunk.names, tokens[0], lengths[0]);
+            if(count == 2) {
+                NodeId dest = internNode(chunk.names, tokens[1], lengths[1]);
+                if(src == dest) {
+                    throw Graph::Edge::EdgeError("A node cannot be connected to itself.");
+                }
+                chunk.edges.push_back(edgeKey(src, dest));
+            }
+        }
+        line = lineEnd + 1;
+    }
+    return chunk;
+}
+
+/**
+ * Parses chunks on the shared thread pool and adds them in the order they were pushed, so the ids don't depend on
+ * timing. Only a few chunks are held at a time, and each chunk interns its own names, so the shared table is only
+ * touched once per distinct name in a chunk.
+ */
+class ChunkQueue {
+    SymbolTable& symbols;
+    std::vector<EdgeKey>& keys;
+    ImportStats& stats;
+    std::deque<std::future<Chunk>> parsing;
+    std::vector<NodeId> map;
+
+    void add(Chunk chunk) {
+        map.resize(chunk.names.bound());
+        for(NodeId id = 0; id < chunk.names.bound(); id++) {
+            map[id] = symbols.intern(chunk.names.data(id), chunk.names.length(id));
+        }
+        for(EdgeKey key : chunk.edges) {
+            keys.push_back(edgeKey(map[keySrc(key)], map[keyDest(key)]));
+        }
+        stats.lines += chunk.lines;
+        stats.chunks++;
+    }
+
+    void addFirst() {
+        std::future<Chunk> chunk = std::move(parsing.front());
+        parsing.pop_front();
+        add(ThreadPool::shared().await(chunk));
+    }
+
+public:
+    ChunkQueue(SymbolTable& s, std::vector<EdgeKey>& k, ImportStats& st) : symbols(s), keys(k), stats(st), parsing(),
+                                                                           map() {}
+    ChunkQueue(const ChunkQueue&) = delete;
+    ChunkQueue& operator=(const ChunkQueue&) = delete;
+
+    /**
+     * Waits for the chunks that are still parsed, since they may read text owned by the caller
+     */
+    ~ChunkQueue() {
+        for(std::future<Chunk>& chunk : parsing) {
+            try {
+                ThreadPool::shared().await(chunk);
+            } catch(...) {}
+        }
+    }
+
+    void push(std::function<Chunk()> parse) {
+        parsing.push_back(ThreadPool::shared().submit(std::move(parse)));
+        if(parsing.size() >= CHUNKS_PER_THREAD * ThreadPool::threads()) {
+            addFirst();
+        }
+    }
+
+    void finish() {
+        while(!parsing.empty()) {
+            addFirst();
+        }
+    }
+};
+
+/**
+ * Reads a text edge list in chunks that are parsed on the shared thread pool
+ * @param symbols Receives the nodes, in the order they first appear in the file
+ * @param keys Receives the edges, unsorted and possibly with duplicates
+ */
+void edgeList::read(const std::string& fname, SymbolTable& symbols, std::vector<EdgeKey>& keys, ImportStats& stats) {
+    std::ifstream file(fname, std::ios::binary);
+    if(!file) {
+        throw std::ifstream::failure("Could not open '" + fname + "'.");
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    stats = ImportStats{0, 0, 0, 0};
+    ChunkQueue chunks(symbols, keys, stats);
+    std::string rest; // The start of a line that continues in the next chunk
+    while(file) {
+        std::shared_ptr<std::string> text = std::make_shared<std::string>(std::move(rest));
+        size_t kept = text->size();
+        text->resize(kept + CHUNK_BYTES);
+        file.read(&(*text)[kept], CHUNK_BYTES);
+        text->resize(kept + file.gcount());
+        stats.bytes += file.gcount();
+        rest.clear();
+        if(file) {
+            size_t cut = text->rfind('\n');
+            if(cut == std::string::npos) {
+                rest.swap(*text);
+                continue;
+            }
+            rest.assign(*text, cut + 1, std::string::npos);
+            text->resize(cut + 1);
+        }
+        if(text->empty()) {
+            continue;
+        }
+        chunks.push([text](){return parseChunk(text->data(), text->data() + text->size());});
+    }
+    chunks.finish();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Parses a text edge list held in memory, in place, the same way read() parses a file
+ */
+void edgeList::parse(const char* text, size_t length, SymbolTable& symbols, std::vector<EdgeKey>& keys,
+                     ImportStats& stats) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    stats = ImportStats{length, 0, 0, 0};
+    ChunkQueue chunks(symbols, keys, stats);
+    const char* end = text + length;
+    for(const char* first = text; first < end;) {
+        const char* last = first + std::min((size_t) (end - first), (size_t) CHUNK_BYTES);
+        const char* cut = last == end ? nullptr : (const char*) std::memchr(last, '\n', end - last);
+        last = cut == nullptr ? end : cut + 1;
+        chunks.push([first, last](){return parseChunk(first, last);});
+        first = last;
+    }
+    chunks.finish();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
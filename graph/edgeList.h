@@ -0,0 +1,24 @@
+#ifndef GCALC_EDGELIST_H
+#define GCALC_EDGELIST_H
+#include "adjacency.h"
+#include "symbolTable.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Totals of one edge list import
+ */
+struct ImportStats {
+    uint64_t bytes;
+    uint64_t lines;
+    uint64_t chunks;
+    double seconds;
+};
+
+namespace edgeList {
+    void read(const std::string& fname, SymbolTable& symbols, std::vector<EdgeKey>& keys, ImportStats& stats);
+    void parse(const char* text, size_t length, SymbolTable& symbols, std::vector<EdgeKey>& keys, ImportStats& stats);
+}
+
+#endif //GCALC_EDGELIST_H
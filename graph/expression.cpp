@@ -0,0 +1,364 @@
+#include "expression.h"
+#include "gcalc.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <unordered_set>
+
+#define COMPLEMENT_OPERATOR '!'
+#define BINARY_OPERATORS "+^-*"
+#define LOAD_FUNCTION "load"
+#define IMPORT_FUNCTION "import"
+
+Expression::Expression(Type t, const std::string& str) : type(t), text(str), operands(), operators(), literal(), error() {}
+
+/**
+ * Scans the edge list of a literal in place, calling f(edge, edgeEnd, src, srcEnd, dest, destEnd) for each of the first
+ * limit edges in order. Edges are separated by ">,". An edge loses its first and last characters, the arrow brackets,
+ * and is split at its first comma into two endpoints that can't be empty.
+ */
+template<class F>
+static void forEachEdge(const char* begin, const char* end, size_t limit, F f) {
+    const char* edge = begin;
+    for(size_t i = 0; i < limit; i++) {
+        const char* close = edge;
+        while(close + 1 < end && !(close[0] == '>' && close[1] == ',')) {
+            close++;
+        }
+        bool last = close + 1 >= end;
+        const char* edgeEnd = last ? end : close + 1;
+        const char* comma = edgeEnd - edge >= 2 ? std::find(edge + 1, edgeEnd - 1, ',') : edge;
+        if(edgeEnd - edge < 2 || comma == edge + 1 || comma >= edgeEnd - 2) {
+            throw Graph::Edge::EdgeError("'" + std::string(edge, edgeEnd) + "' is not a valid edge!");
+        }
+        f(edge, edgeEnd, edge + 1, comma, comma + 1, edgeEnd - 1);
+        if(last) {
+            break;
+        }
+        edge = close + 2;
+    }
+}
+
+/**
+ * Throws the error for the first edge that repeats an earlier one, among the first count edges of a literal.
+ * Only runs once a literal is known to be invalid, so it can afford to copy the edges.
+ */
+static void checkRepeats(const char* begin, const char* end, size_t count) {
+    std::unordered_set<std::string> seen;
+    forEachEdge(begin, end, count, [&](const char* edge, const char* edgeEnd, const char* src, const char*, const char*,
+                                       const char* destEnd) {
+        if(!seen.insert(std::string(src, destEnd)).second) {
+            throw Graph::GraphException(std::string(edge, edgeEnd), "is already in the graph!");
+        }
+    });
+}
+
+/**
+ * Parses a graph literal in one pass, without copying its parts, and builds the graph at once.
+ * Errors are thrown in the order adding the nodes, then the edges, one by one would throw them.
+ */
+Graph Expression::parseGraph(const std::string& graph) {
+    assert(graph.front() == '{');
+    if(graph.back() != '}') {
+        throw GCalc::InvalidExpression(graph);
+    }
+    const char* begin = graph.data() + 1;
+    const char* end = graph.data() + graph.size() - 1;
+    const char* bar = std::find(begin, end, '|'); // The nodes are before the first bar and the edges after it
+    SymbolTable symbols;
+    for(const char* node = begin, *comma = begin; bar != begin && comma != bar; node = comma + 1) {
+        comma = std::find(node, bar, ',');
+        if(symbols.find(node, comma - node) != SymbolTable::NONE) {
+            throw Graph::GraphException(std::string(node, comma), "cannot be in the graph more than one time!");
+        }
+        if(!Graph::validNode(node, comma - node)) {
+            throw Graph::InvalidName(std::string(node, comma));
+        }
+        symbols.intern(node, comma - node);
+    }
+    std::vector<EdgeKey> keys;
+    const char* edges = bar == end ? end : bar + 1;
+    if(edges != end) {
+        try {
+            forEachEdge(edges, end, SIZE_MAX, [&](const char*, const char*, const char* src, const char* srcEnd,
+                                                  const char* dest, const char* destEnd) {
+                NodeId srcId = symbols.find(src, srcEnd - src), destId = symbols.find(dest, destEnd - dest);
+                if(srcId == SymbolTable::NONE) {
+                    throw Graph::NodeNotFound(std::string(src, srcEnd));
+                } else if(destId == SymbolTable::NONE) {
+                    throw Graph::NodeNotFound(std::string(dest, destEnd));
+                } else if(srcId == destId) {
+                    throw Graph::Edge::EdgeError("A node cannot be connected to itself.");
+                }
+                keys.push_back(edgeKey(srcId, destId));
+            });
+        } catch(const std::invalid_argument&) {
+            checkRepeats(edges, end, keys.size()); // An edge before the failing one may be a repeat
+            throw;
+        }
+    }
+    size_t count = keys.size();
+    Graph result = Graph::build(std::move(symbols), keys);
+    if(keys.size() < count) {
+        checkRepeats(edges, end, count);
+    }
+    return result;
+}
+
+/**
+ * Recursive descent parser over the characters of an expression:
+ *     chain   := unary (operator unary)*
+ *     unary   := '!' unary | '(' chain ')' | (load | import) '(' file ')' | operand
+ * An operand is the longest run of characters that are neither operators nor brackets.
+ */
+class Parser {
+    const std::string& expression;
+    size_t position;
+
+    bool atOperator() const {
+        return position < expression.size() && std::strchr(BINARY_OPERATORS, expression[position]) != nullptr;
+    }
+
+    bool at(char c) const {
+        return position < expression.size() && expression[position] == c;
+    }
+
+    Expression::Ptr chain();
+    Expression::Ptr unary();
+    Expression::Ptr operand();
+
+public:
+    explicit Parser(const std::string& e) : expression(e), position(0) {}
+    Expression::Ptr parse();
+
+    GCalc::InvalidExpression invalid() const {
+        return GCalc::InvalidExpression(expression);
+    }
+};
+
+Expression::Ptr Parser::parse() {
+    if(expression.find('$') != std::string::npos) {
+        throw invalid();
+    }
+    Expression::Ptr result = chain();
+    if(position != expression.size()) {
+        throw invalid();
+    }
+    return result;
+}
+
+Expression::Ptr Parser::chain() {
+    Expression::Ptr first = unary();
+    if(!atOperator()) {
+        return first;
+    }
+    std::shared_ptr<Expression> result = std::make_shared<Expression>(Expression::CHAIN);
+    result->operands.push_back(first);
+    while(atOperator()) {
+        result->operators.push_back(expression[position++]);
+        result->operands.push_back(unary());
+    }
+    return result;
+}
+
+Expression::Ptr Parser::unary() {
+    if(at(COMPLEMENT_OPERATOR)) {
+        position++;
+        std::shared_ptr<Expression> result = std::make_shared<Expression>(Expression::COMPLEMENT);
+        result->operands.push_back(unary());
+        return result;
+    } else if(at('(')) {
+        position++;
+        Expression::Ptr result = chain();
+        if(!at(')')) {
+            throw invalid();
+        }
+        position++;
+        return result;
+    }
+    return operand();
+}
+
+Expression::Ptr Parser::operand() {
+    size_t start = position;
+    while(position < expression.size() && !atOperator() && !at('(') && !at(')')) {
+        position++;
+    }
+    std::string text = expression.substr(start, position - start);
+    if(text.empty()) {
+        throw invalid();
+    }
+    if((text == LOAD_FUNCTION || text == IMPORT_FUNCTION) && at('(')) {
+        // The file name runs to the matching bracket
+        size_t open = ++position;
+        for(int depth = 1; depth > 0; position++) {
+            if(position == expression.size()) {
+                throw invalid();
+            }
+            depth += at('(') ? 1 : (at(')') ? -1 : 0);
+        }
+        Expression::Type type = text == LOAD_FUNCTION ? Expression::LOAD : Expression::IMPORT;
+        return std::make_shared<Expression>(type, expression.substr(open, position - open - 1));
+    }
+    if(text.front() != '{') {
+        return std::make_shared<Expression>(Expression::VARIABLE, text);
+    }
+    std::shared_ptr<Expression> result = std::make_shared<Expression>(Expression::LITERAL, text);
+    try {
+        result->literal = std::make_shared<Graph>(Expression::parseGraph(text));
+        result->literal->settle(); // Plans are shared, so the literal may be read by several statements at once
+    } catch(const std::invalid_argument&) {
+        result->error = std::current_exception();
+    }
+    return result;
+}
+
+/**
+ * Parses an expression whose whitespace was already removed
+ */
+Expression::Ptr Expression::compile(const std::string& expression) {
+    return Parser(expression).parse();
+}
+
+/**
+ * @return A text that is the same for two nodes only if they always evaluate to the same graph
+ */
+static std::string shape(const Expression& expression) {
+    switch(expression.type) {
+        case Expression::VARIABLE:
+        case Expression::LITERAL:
+            return expression.text;
+        case Expression::VALUE:
+            if(!expression.text.empty()) {
+                return '#' + expression.text;
+            }
+            break;
+        case Expression::LOAD:
+        case Expression::IMPORT:
+            break;
+        case Expression::COMPLEMENT:
+            return '!' + shape(*expression.operands[0]);
+        case Expression::CHAIN: {
+            std::string result = "(" + shape(*expression.operands[0]);
+            for(unsigned i = 1; i < expression.operands.size(); i++) {
+                result += expression.operators[i - 1] + shape(*expression.operands[i]);
+            }
+            return result + ")";
+        }
+    }
+    // Files can change between reads and unnamed values are only equal to themselves
+    return '@' + std::to_string((uintptr_t) &expression);
+}
+
+static Expression::Ptr emptyGraph() {
+    std::shared_ptr<Expression> result = std::make_shared<Expression>(Expression::LITERAL, "{}");
+    result->literal = std::make_shared<Graph>();
+    return result;
+}
+
+/**
+ * Rewrites an expression into one that evaluates to the same graph with less work:
+ *     !!G         G, since complements never have self loops
+ *     (A op B) op C    A op B op C, since operators associate to the left
+ *     A - B ^ B   the empty graph, and so does any run of '-' and '^' between them, since B's nodes are gone
+ *     A ^ A       A, and the same for '+', for repeated operands in a leading run of the same operator
+ */
+Expression::Ptr Expression::simplify(const Ptr& expression) {
+    if(expression->type == COMPLEMENT) {
+        Ptr operand = simplify(expression->operands[0]);
+        if(operand->type == COMPLEMENT) {
+            return operand->operands[0];
+        }
+        if(operand == expression->operands[0]) {
+            return expression;
+        }
+        std::shared_ptr<Expression> result = std::make_shared<Expression>(COMPLEMENT);
+        result->operands.push_back(operand);
+        return result;
+    }
+    if(expression->type != CHAIN) {
+        return expression;
+    }
+    std::vector<Ptr> operands;
+    std::string operators;
+    Ptr first = simplify(expression->operands[0]);
+    if(first->type == CHAIN) {
+        operands = first->operands;
+        operators = first->operators;
+    } else {
+        operands.push_back(first);
+    }
+    for(unsigned i = 1; i < expression->operands.size(); i++) {
+        operators += expression->operators[i - 1];
+        operands.push_back(simplify(expression->operands[i]));
+    }
+
+    std::set<std::string> removed; // Operands whose nodes are not in the result so far
+    for(unsigned i = 1; i < operands.size(); i++) {
+        char op = operators[i - 1];
+        if(op == '-') {
+            removed.insert(shape(*operands[i]));
+        } else if(op == '^' && removed.count(shape(*operands[i])) > 0) {
+            operands.erase(operands.begin(), operands.begin() + i);
+            operators.erase(0, i);
+            operands.front() = emptyGraph();
+            removed.clear();
+            i = 0;
+        } else if(op != '^') {
+            removed.clear();
+        }
+    }
+
+    if(!operators.empty() && (operators[0] == '^' || operators[0] == '+')) {
+        std::set<std::string> seen {shape(*operands[0])};
+        unsigned i = 1;
+        while(i < operands.size() && operators[i - 1] == operators[0]) {
+            if(seen.insert(shape(*operands[i])).second) {
+                i++;
+            } else {
+                operands.erase(operands.begin() + i);
+                operators.erase(i - 1, 1);
+            }
+        }
+    }
+
+    if(operands.size() == 1) {
+        return operands[0];
+    }
+    std::shared_ptr<Expression> result = std::make_shared<Expression>(CHAIN);
+    result->operands = operands;
+    result->operators = operators;
+    return result;
+}
+
+unsigned Expression::depth() const {
+    unsigned deepest = 0;
+    for(const Ptr& operand : operands) {
+        deepest = std::max(deepest, operand->depth());
+    }
+    return deepest + 1;
+}
+
+/**
+ * @return The memory the expression keeps: its texts and the graphs of its literals
+ */
+size_t Expression::bytes() const {
+    size_t total = sizeof(Expression) + text.capacity() + operators.capacity() + (literal ? literal->bytes() : 0);
+    for(const Ptr& operand : operands) {
+        total += operand->bytes();
+    }
+    return total;
+}
+
+/**
+ * @return The number of nodes, counting shared nodes every time they are reached, or more than limit once it is
+ */
+size_t Expression::size(size_t limit) const {
+    size_t total = 1;
+    for(unsigned i = 0; i < operands.size() && total <= limit; i++) {
+        total += operands[i]->size(limit - total);
+    }
+    return total;
+}
@@ -0,0 +1,38 @@
+#ifndef GCALC_EXPRESSION_H
+#define GCALC_EXPRESSION_H
+#include "graph.h"
+#include <exception>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * A compiled GCalc expression.
+ * Binary operators all have the same precedence and associate to the left, so a run of them is kept as one
+ * chain node instead of a deep tree. The prefix '!' binds tighter than any binary operator.
+ * Nodes are immutable once compiled, so a plan can be cached and evaluated any number of times.
+ * A value node holds a graph taken from a variable or a file when a lazy expression was bound, and is named after
+ * the variable and its version, or not named at all.
+ */
+struct Expression {
+    typedef std::shared_ptr<const Expression> Ptr;
+    enum Type {VARIABLE, LITERAL, LOAD, IMPORT, COMPLEMENT, CHAIN, VALUE};
+
+    Type type;
+    std::string text; // The variable name, the literal, the file name or the value's name
+    std::vector<Ptr> operands;
+    std::string operators; // operators[i] joins operands[i] and operands[i + 1] in a chain
+    SharedGraph literal; // The graph of a literal or a value
+    std::exception_ptr error; // Thrown when the literal is evaluated, so errors keep their order
+
+    explicit Expression(Type, const std::string& text = "");
+
+    static Ptr compile(const std::string&);
+    static Ptr simplify(const Ptr&);
+    unsigned depth() const;
+    size_t size(size_t limit) const;
+    size_t bytes() const;
+    static Graph parseGraph(const std::string&);
+};
+
+#endif //GCALC_EXPRESSION_H
@@ -0,0 +1,185 @@
+#include "fileCache.h"
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static thread_local unsigned filling = 0; // Files this thread is reading for the cache
+
+FileCache::FileCache(size_t b) : entries(), uses(), budget(b), used(0), generations(0), hitCount(0), missCount(0),
+                                 mutex(), io(PREFETCH_THREADS) {}
+
+/**
+ * @return The absolute path without links, or the path as it is if it can't be resolved
+ */
+static std::string canonical(const std::string& fname) {
+    char* resolved = realpath(fname.c_str(), nullptr);
+    if(resolved == nullptr) {
+        return fname;
+    }
+    std::string path(resolved);
+    std::free(resolved);
+    return path;
+}
+
+/**
+ * @return What changes whenever the file is written or replaced, or an empty string if there is no such file
+ */
+static std::string stampOf(const std::string& path) {
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0) {
+        return std::string();
+    }
+    return std::to_string(info.st_dev) + ':' + std::to_string(info.st_ino) + ':' + std::to_string(info.st_size) + ':' +
+           std::to_string(info.st_mtim.tv_sec) + '.' + std::to_string(info.st_mtim.tv_nsec);
+}
+
+/**
+ * Drops a graph. Loads that already hold its value keep it.
+ */
+void FileCache::erase(std::unordered_map<std::string, Entry>::iterator entry) {
+    used -= entry->second.bytes;
+    uses.erase(entry->second.use);
+    entries.erase(entry);
+}
+
+/**
+ * Finds the graph of a file that still has the same stamp, or starts loading it. Called with the mutex held.
+ * @return The promise to fulfil if the caller has to load the file, or null if the graph is cached or being loaded
+ */
+std::shared_ptr<std::promise<SharedGraph>> FileCache::start(const std::string& path, const std::string& stamp,
+                                                            uint64_t& generation, std::shared_future<SharedGraph>& value) {
+    auto iter = entries.find(path);
+    if(iter != entries.end() && !stamp.empty() && iter->second.stamp == stamp) {
+        uses.splice(uses.begin(), uses, iter->second.use);
+        value = iter->second.value;
+        return nullptr;
+    }
+    if(iter != entries.end()) {
+        erase(iter);
+    }
+    std::shared_ptr<std::promise<SharedGraph>> promise = std::make_shared<std::promise<SharedGraph>>();
+    value = promise->get_future().share();
+    generation = ++generations;
+    uses.push_front(path);
+    entries[path] = {stamp, value, generation, 0, uses.begin()};
+    return promise;
+}
+
+/**
+ * Loads a file for the entry that start() made, by the name it was given so errors name the file the same way.
+ * A file that changed while it was read is not kept for later loads, and a file that couldn't be loaded is dropped
+ * so the next load tries again.
+ */
+void FileCache::fill(const std::string& path, const std::string& fname, const std::string& stamp, uint64_t generation,
+                     std::promise<SharedGraph>& promise) {
+    SharedGraph value;
+    try {
+        filling++;
+        value = std::make_shared<Graph>(Graph::load(fname));
+        value->settle();
+        filling--;
+    } catch(...) {
+        filling--;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto iter = entries.find(path);
+            if(iter != entries.end() && iter->second.generation == generation) {
+                erase(iter);
+            }
+        }
+        promise.set_exception(std::current_exception());
+        return;
+    }
+    bool changed = stampOf(path) != stamp;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = entries.find(path);
+        if(iter != entries.end() && iter->second.generation == generation) {
+            if(changed) {
+                iter->second.stamp.clear();
+            }
+            iter->second.bytes = value->bytes();
+            used += iter->second.bytes;
+            while(used > budget) {
+                erase(entries.find(uses.back()));
+            }
+        }
+    }
+    promise.set_value(value);
+}
+
+/**
+ * @return The graph of a file, read now, taken from an earlier load or prefetch, or waited for if it is being read
+ */
+SharedGraph FileCache::load(const std::string& fname) {
+    std::string path = canonical(fname), stamp = stampOf(path);
+    uint64_t generation = 0;
+    std::shared_future<SharedGraph> value;
+    std::shared_ptr<std::promise<SharedGraph>> promise;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        promise = start(path, stamp, generation, value);
+        (promise ? missCount : hitCount)++;
+    }
+    if(!promise) {
+        // A thread reading a file runs queued statements while it waits for its own tasks, and such a statement
+        // can't wait for a read that may be blocked behind it, so it reads the file itself
+        try {
+            if(filling == 0 || value.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                return value.get();
+            }
+        } catch(...) {} // A failed prefetch is retried, so the error is the one this load would throw
+        SharedGraph graph = std::make_shared<Graph>(Graph::load(fname));
+        graph->settle();
+        return graph;
+    }
+    fill(path, fname, stamp, generation, *promise);
+    return value.get();
+}
+
+/**
+ * Starts reading a file on a background thread, unless its graph is already cached or being read.
+ * Files that don't exist yet are skipped, since they may be written before they are loaded.
+ */
+void FileCache::prefetch(const std::string& fname) {
+    std::string path = canonical(fname), stamp = stampOf(path);
+    if(stamp.empty()) {
+        return;
+    }
+    uint64_t generation = 0;
+    std::shared_future<SharedGraph> value;
+    std::shared_ptr<std::promise<SharedGraph>> promise;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        promise = start(path, stamp, generation, value);
+    }
+    if(!promise) {
+        return;
+    }
+    io.submit([this, path, stamp, generation, promise]() {
+        // Mapped graph files are only read as they are used, so have the kernel read the file meanwhile
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            close(fd);
+        }
+        fill(path, path, stamp, generation, *promise);
+    });
+}
+
+uint64_t FileCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hitCount;
+}
+
+uint64_t FileCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return missCount;
+}
+
+size_t FileCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,59 @@
+#ifndef GCALC_FILECACHE_H
+#define GCALC_FILECACHE_H
+#include "graph.h"
+#include "threadPool.h"
+#include <cstdint>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#define FILE_CACHE_BYTES ((size_t) 256 << 20) // Memory the loaded files may take before the oldest are dropped
+#define PREFETCH_THREADS 2
+
+/**
+ * Graphs loaded from files, by the file's canonical path. A graph is kept while the file keeps its size, modification
+ * time and inode, so loading the same file again only checks it, and a file that was saved over is read again.
+ * Files can be prefetched on background threads, and a load waits for the prefetch of its file instead of reading
+ * the file again. The graphs are settled and shared, so whoever changes one has to copy it first.
+ * Once the graphs take more memory than the budget, the least recently used ones are dropped.
+ */
+class FileCache {
+    struct Entry {
+        std::string stamp; // The size, modification time and inode of the file when it was read
+        std::shared_future<SharedGraph> value;
+        uint64_t generation; // Tells a reload of the same file apart from the load it replaced
+        size_t bytes; // Zero until the graph is loaded
+        std::list<std::string>::iterator use;
+    };
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> uses; // Most recently used first
+    size_t budget;
+    size_t used;
+    uint64_t generations;
+    uint64_t hitCount;
+    uint64_t missCount;
+    mutable std::mutex mutex;
+    ThreadPool io; // Last, so prefetches still running finish before the rest of the cache is destroyed
+
+    std::shared_ptr<std::promise<SharedGraph>> start(const std::string& path, const std::string& stamp,
+                                                     uint64_t& generation, std::shared_future<SharedGraph>& value);
+    void fill(const std::string& path, const std::string& fname, const std::string& stamp, uint64_t generation,
+              std::promise<SharedGraph>&);
+    void erase(std::unordered_map<std::string, Entry>::iterator);
+
+public:
+    explicit FileCache(size_t budget = FILE_CACHE_BYTES);
+    FileCache(const FileCache&) = delete;
+    FileCache& operator=(const FileCache&) = delete;
+
+    SharedGraph load(const std::string& fname);
+    void prefetch(const std::string& fname);
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+    size_t size() const;
+};
+
+#endif //GCALC_FILECACHE_H
@@ -1,48 +1,109 @@
 #include "gcalc.h"
 #include "../stringUtils.h"
+#include "threadPool.h"
 #include <algorithm>
-#include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
 #include <string>
 #include <fstream>
-#include <regex>
+#include <iomanip>
+#include <sstream>
 
 #define MESSAGE "Gcalc> "
-#define COMPLEMENT_OPERATOR '!'
+#define PLAN_CACHE_SIZE 4096
+#define PLAN_CACHE_BYTES ((size_t) 64 << 20) // Memory the plans may keep, a larger plan is compiled every time
+#define LAZY_MAX_DEPTH 32 // Lazy expressions deeper than this are evaluated when they are assigned
+#define LAZY_MAX_NODES 1024 // And so are lazy expressions with more nodes, counting shared nodes every time
+#define FILES "/" // Stands for the file system in the accesses of a statement, no variable can have this name
+#define STATS_RESET "stats reset"
+#define STATS_VARIABLE "GCALC_STATS" // The counters are written to this file as JSON when the session ends
 
-#define GET_VARIABLE(out, name) auto (out) = variables.find(name); \
+#define GET_VARIABLE(out, name) auto out = variables.find(name); \
 if((out) == variables.end()) { \
 throw Graph::GraphException(name, "is undefined."); \
 }
 
-const std::set<std::string> statements {"who", "reset", "quit"};
+const std::set<std::string> statements {"who", "reset", "quit", "cache", "stats", STATS_RESET};
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static thread_local double parseSeconds = 0; // Time the statement running on this thread spent compiling
+static std::atomic<unsigned> operandTasks(0); // Operands being evaluated as tasks of their own, at any depth
 
 const std::map<char, GCalc::Operator> GCalc::operators {
-        {'+', Graph::unite},
-        {'^', Graph::intersection},
-        {'-', Graph::difference},
-        {'*', Graph::product}
+        {'+', [](Graph& g1, const std::vector<const Graph*>& g2){g1.uniteWith(g2);}},
+        {'^', [](Graph& g1, const std::vector<const Graph*>& g2){g1.intersectWith(g2);}},
+        {'-', [](Graph& g1, const std::vector<const Graph*>& g2){g1.subtract(g2);}},
+        {'*', [](Graph& g1, const std::vector<const Graph*>& g2) {
+            for(const Graph* g : g2) {
+                g1 = Graph::product(g1, *g);
+            }
+        }}
+};
+
+const std::map<std::string, Graph::Format> formats {
+        {"text", Graph::TEXT}, {"edges", Graph::EDGE_LIST}, {"dot", Graph::DOT}, {"binary", Graph::BINARY}
 };
 
+/**
+ * Splits the parameters of a function at the commas that are outside of literals and brackets
+ */
+static std::vector<std::string> arguments(const std::string& params) {
+    std::vector<std::string> result(1);
+    int depth = 0;
+    for(char c : params) {
+        depth += (c == '{' || c == '(') ? 1 : ((c == '}' || c == ')') ? -1 : 0);
+        if(c == ',' && depth == 0) {
+            result.emplace_back();
+        } else {
+            result.back() += c;
+        }
+    }
+    return result;
+}
+
 static bool isStatement(const std::string& str) {
     return statements.find(str) != statements.end();
 }
 
-static bool isFunction(const std::string& str) {
-    return str == "print" || str == "delete" || str == "save" || str == "load";
+/**
+ * Names that can't be variables, the statements and functions of the first version of the language. The ones added
+ * since are only keywords where they are called, so scripts that named variables after them keep working.
+ */
+static bool isReserved(const std::string& str) {
+    return str == "who" || str == "reset" || str == "quit" || str == "print" || str == "delete" || str == "save" ||
+           str == "load";
 }
 
-GCalc::GCalc(std::ifstream* is, std::ofstream* os, bool io) : variables(), in(is), out(os), ioRedirected(io) {
+static bool isVariableName(const std::string& str) {
+    return !isReserved(str) && !str.empty() && isalpha(str[0]) && std::all_of(str.begin() + 1, str.end(), isalnum);
+}
+
+GCalc::GCalc(std::ifstream* is, std::ofstream* os, bool io) : variables(), plans(), planBytes(0), versions(), lastVersion(0), lazy(false), cache(),
+                                                             files(), stats(), mutex(), journal(), journalName(), journalMutex(),
+                                                             in(is), out(os), ioRedirected(io) {
     if(ioRedirected) {
         std::cin.rdbuf(in->rdbuf());
         std::cout.rdbuf(out->rdbuf());
     }
 }
 
-GCalc::GCalc(GCalc&& g) noexcept : variables(std::move(g.variables)), in(g.in), out(g.out), ioRedirected(g.ioRedirected) {}
+GCalc::GCalc(GCalc&& g) noexcept : variables(std::move(g.variables)), plans(std::move(g.plans)),
+                                   planBytes(g.planBytes), versions(std::move(g.versions)), lastVersion(g.lastVersion), lazy(g.lazy), cache(), files(), stats(), mutex(),
+                                   journal(std::move(g.journal)), journalName(std::move(g.journalName)), journalMutex(),
+                                   in(g.in), out(g.out), ioRedirected(g.ioRedirected) {}
 
 GCalc::GCalc() : GCalc(nullptr, nullptr, false) {}
 GCalc::~GCalc() {
     if(ioRedirected) {
+        // Detach the standard streams first, they are still flushed at exit
+        std::cin.rdbuf(nullptr);
+        std::cout.rdbuf(nullptr);
         in->close();
         out->close();
         delete in;
@@ -52,242 +113,918 @@ GCalc::~GCalc() {
 
 GCalc::InvalidExpression::InvalidExpression(const std::string& e): Graph::GraphException(e, "is not a valid expression.") {}
 
-void GCalc::printVariables() const {
+void GCalc::printVariables(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex);
     for(const auto& literal : variables) {
-        std::cout << literal.first << std::endl;
+        os << literal.first << std::endl;
     }
 }
 
+void GCalc::printCache(std::ostream& os) const {
+    os << "hits: " << cache.hits() << ", misses: " << cache.misses() << ", results: " << cache.size() << ", bytes: "
+       << cache.bytes() << std::endl;
+    os << "file hits: " << files.hits() << ", misses: " << files.misses() << ", files: " << files.size() << std::endl;
+}
+
+void GCalc::printStats(std::ostream& os) const {
+    stats.print(os);
+}
+
 void GCalc::deleteGraph(std::string& params) {
-    GET_VARIABLE(iter, params);
-    variables.erase(iter);
+    Variable value;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        GET_VARIABLE(iter, params);
+        std::swap(value, iter->second); // Freed after the lock is released
+        variables.erase(iter);
+        versions.erase(params);
+    }
+    stats.variable(params, 0);
+    cache.invalidate(params);
+}
+
+/**
+ * Gives a variable that was just assigned a new version, and drops the cached results of its old value
+ */
+void GCalc::changed(const std::string& variableName) {
+    size_t bytes = 0; // Lazy variables take no memory until they are evaluated
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        versions[variableName] = ++lastVersion;
+        auto iter = variables.find(variableName);
+        if(iter != variables.end() && iter->second.value) {
+            bytes = iter->second.value->bytes();
+        }
+    }
+    stats.variable(variableName, bytes);
+    cache.invalidate(variableName);
 }
 
+/**
+ * Saves 'expression, file' as a graph file, or 'expression, file, packed' and 'expression, file, compressed' in the
+ * smaller packed format, see Graph::archive(). load() tells the formats apart.
+ */
 void GCalc::saveGraph(const std::string& params) const {
-    unsigned long index = params.rfind(',');
-    if(index == std::string::npos) {
+    std::vector<std::string> args = arguments(params);
+    if(args.size() < 2) {
         throw std::invalid_argument("No file specified!");
     }
-    std::string expression(params.begin(), params.begin() + index), fName(params.begin() + index + 1, params.end());
+    if(args.size() > 3 || (args.size() == 3 && args[2] != "packed" && args[2] != "compressed")) {
+        throw Graph::GraphException(args.back(), "is not a valid save mode.");
+    }
+    SharedGraph graph = parseExpression(args[0]);
     try {
-        parseExpression(expression).save(fName);
+        if(args.size() == 2) {
+            graph->save(args[1]);
+        } else {
+            graph->archive(args[1], args[2] == "compressed");
+        }
     } catch(const std::ifstream::failure&) {
         throw std::invalid_argument("Could not open the file.");
     }
 }
 
-Graph GCalc::loadGraph(const std::string& params) {
-    std::ifstream graphFile;
+/**
+ * Prints 'expression', 'expression, format' or 'expression, format, file'. Without a format the graph is printed
+ * as text, and without a file it is printed to os, except for the binary format which needs one.
+ */
+void GCalc::printGraph(const std::string& params, std::ostream& os) const {
+    std::vector<std::string> args = arguments(params);
+    if(args.size() == 1 || args.size() > 3) {
+        os << *parseExpression(params) << '\n';
+        return;
+    }
+    auto format = formats.find(args[1]);
+    if(format == formats.end()) {
+        throw Graph::GraphException(args[1], "is not a valid format.");
+    }
+    if(args.size() == 2 && format->second == Graph::BINARY) {
+        throw std::invalid_argument("No file specified!");
+    }
+    SharedGraph graph = parseExpression(args[0]);
+    if(args.size() == 2) {
+        graph->write(os, format->second);
+        os << (format->second == Graph::TEXT ? "\n" : "");
+        return;
+    }
+    std::ofstream file(args[2], std::ios::binary);
+    if(!file) {
+        throw std::invalid_argument("Could not open the file.");
+    }
+    graph->write(file, format->second);
+    file << (format->second == Graph::TEXT ? "\n" : "");
+}
+
+void GCalc::printAdjacent(const std::string& params, bool incoming, std::ostream& os) const {
+    unsigned long index = params.rfind(',');
+    if(index == std::string::npos) {
+        throw std::invalid_argument("No node specified!");
+    }
+    std::string expression(params.begin(), params.begin() + index);
+    Node node(params.begin() + index + 1, params.end());
+    SharedGraph graph = parseExpression(expression);
+    for(const Node& n : incoming ? graph->predecessors(node) : graph->neighbours(node)) {
+        os << n << std::endl;
+    }
+}
+
+/**
+ * Loads a graph file through the file cache, so a file that is loaded again is only read again once it changed
+ */
+SharedGraph GCalc::loadGraph(const std::string& params) const {
     try {
-        return Graph::load(params);
+        return files.load(params);
     } catch(const std::ifstream::failure&) {
         throw std::invalid_argument("Could not open '" + params + "'.");
     }
+}
 
+/**
+ * Imports a text edge list and reports the totals on std::cerr, so they don't mix with the printed graphs
+ */
+Graph GCalc::importGraph(const std::string& params) {
+    ImportStats stats;
+    try {
+        Graph result = Graph::import(params, stats);
+        std::ostringstream report;
+        report << std::fixed << std::setprecision(2) << "Imported '" << params << "': " << result.getNodes().size()
+               << " nodes, " << result.edgeCount() << " edges from " << stats.lines << " lines in " << stats.seconds
+               << "s (" << stats.bytes / 1e6 / std::max(stats.seconds, 1e-9) << " MB/s)";
+        std::cerr << report.str() << std::endl;
+        return result;
+    } catch(const std::ifstream::failure&) {
+        throw std::invalid_argument("Could not open '" + params + "'.");
+    }
 }
 
-void GCalc::runStatement(const std::string& statement) {
+void GCalc::runStatement(const std::string& statement, std::ostream& os) {
     if(statement == "who") {
-        printVariables();
+        printVariables(os);
     } else if(statement == "reset") {
-        variables.clear();
+        std::map<std::string, Variable> values;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            values.swap(variables);
+            versions.clear();
+        }
+        for(const auto& variable : values) {
+            stats.variable(variable.first, 0);
+        }
+        cache.clear();
+    } else if(statement == "cache") {
+        printCache(os);
+    } else if(statement == "stats") {
+        printStats(os);
+    } else if(statement == STATS_RESET) {
+        stats.reset();
     }
 }
 
-std::pair<Node, Node> GCalc::parseEdge(std::string edge) {
-    assert(edge.front() == '<' && edge.back() == '>');
-    std::string originalEdge(edge);
-    edge.erase(0, 1);
-    edge.pop_back();
-    auto endpoints = stringUtils::partition(edge, ",");
-    if(std::any_of(endpoints.begin(), endpoints.end(), [](const std::string& s){return s.empty();})) {
-        throw Graph::Edge::EdgeError("'" + originalEdge + "' is not a valid edge!");
+/**
+ * Compiles an expression, reusing the plan if the same text was compiled before.
+ * The plans are dropped once there are PLAN_CACHE_SIZE of them or they keep more than PLAN_CACHE_BYTES, so large
+ * literals are not kept for the whole session. A plan larger than that is compiled again every time.
+ * The plans are only locked to look a plan up and to add it: building a large literal waits for tasks of its own,
+ * and a thread waiting for tasks runs other statements, which lock the plans too.
+ */
+Expression::Ptr GCalc::compile(const std::string& expression) const {
+    Clock::time_point start = Clock::now();
+    Expression::Ptr plan;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = plans.find(expression);
+        if(iter != plans.end()) {
+            plan = iter->second;
+        }
     }
-    return {endpoints[0], endpoints[2]};
+    if(!plan) {
+        plan = Expression::compile(expression);
+        size_t bytes = expression.capacity() + plan->bytes();
+        std::lock_guard<std::mutex> lock(mutex);
+        if(bytes <= PLAN_CACHE_BYTES) {
+            if(plans.size() >= PLAN_CACHE_SIZE || planBytes + bytes > PLAN_CACHE_BYTES) {
+                plans.clear();
+                planBytes = 0;
+            }
+            auto added = plans.emplace(expression, plan); // Another statement may have compiled it meanwhile
+            planBytes += added.second ? bytes : 0;
+            plan = added.first->second;
+        }
+    }
+    parseSeconds += secondsSince(start);
+    return plan;
 }
 
-Graph GCalc::parseGraph(std::string graph) {
-    assert(graph.front() == '{');
-    if(graph.back() != '}') {
-        throw InvalidExpression(graph);
-    }
-    graph.erase(0, 1);
-    graph.pop_back();
-    auto partitioned = stringUtils::partition(graph, "|");
-    std::string nodes = partitioned[0], edges = partitioned[2];
-    Graph result;
-    if(!nodes.empty()) {
-        for(const Node& node : stringUtils::split(nodes, ",")) {
-            if(result.containsNode(node)) {
-                throw Graph::GraphException(node, "cannot be in the graph more than one time!");
+/**
+ * Builds the key of an expression's result: its text, with every variable it reads followed by the variable's version
+ * @param reads Gets the variables the expression reads
+ * @return Whether the result can be cached. Results read from files or from undefined variables can't be.
+ */
+bool GCalc::cacheKey(const Expression& expression, std::string& key, std::vector<std::string>& reads) const {
+    switch(expression.type) {
+        case Expression::VARIABLE: {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto version = versions.find(expression.text);
+            if(version == versions.end()) {
+                return false;
             }
-            result.addNode(node);
+            key += expression.text + '#' + std::to_string(version->second);
+            reads.push_back(expression.text);
+            return true;
+        }
+        case Expression::LITERAL:
+            key += expression.text;
+            return !expression.error;
+        case Expression::VALUE:
+            key += expression.text;
+            return !expression.text.empty();
+        case Expression::LOAD:
+        case Expression::IMPORT:
+            return false;
+        case Expression::COMPLEMENT:
+            key += '!';
+            return cacheKey(*expression.operands[0], key, reads);
+        case Expression::CHAIN:
+            break;
+    }
+    key += '(';
+    for(unsigned i = 0; i < expression.operands.size(); i++) {
+        if(i > 0) {
+            key += expression.operators[i - 1];
+        }
+        if(!cacheKey(*expression.operands[i], key, reads)) {
+            return false;
         }
     }
-    if(!partitioned.back().empty()) {
-        std::vector<std::string> e = stringUtils::split(partitioned.back(), ">,"); // Only seperates edges, not the nodes in them
-        for(unsigned i = 0; i < e.size(); i++) {
-            std::string edge = e[i] + (i == e.size() - 1 ? "":">");
-            std::pair<Node, Node> endPoints = parseEdge(edge); // Add the closing arrow bracket back
-            if(result.adjacent(endPoints.first, endPoints.second)) {
-                throw Graph::GraphException(edge, "is already in the graph!");
+    key += ')';
+    return true;
+}
+
+/**
+ * Evaluates a compiled expression. Variables, literals and loaded files are returned as they are stored, without
+ * copying them, and other results are cached while the variables they read keep their versions.
+ */
+SharedGraph GCalc::evaluate(const Expression& expression) const {
+    switch(expression.type) {
+        case Expression::VARIABLE:
+            return valueOf(expression.text);
+        case Expression::LITERAL:
+            if(expression.error) {
+                std::rethrow_exception(expression.error);
             }
-            result.addEdge(endPoints.first, endPoints.second);
+            return expression.literal;
+        case Expression::VALUE:
+            return expression.literal;
+        case Expression::LOAD:
+            return loadGraph(expression.text);
+        default:
+            break;
+    }
+    std::string key;
+    std::vector<std::string> reads;
+    bool cacheable = cacheKey(expression, key, reads);
+    SharedGraph value = cacheable ? cache.find(key) : nullptr;
+    if(!value) {
+        std::shared_ptr<Graph> result = std::make_shared<Graph>(evaluateValue(expression));
+        stats.allocation(result->bytes());
+        if(cacheable) {
+            result->compact(); // Cached results are kept and shared between statements, so only now can it change
+        }
+        value = result;
+        if(cacheable) {
+            cache.insert(key, value, reads);
         }
     }
-    return result;
+    return value;
 }
 
-std::vector<Graph> GCalc::handleBrackets(std::string& e, unsigned startIndex) const {
-    bool validExpression = true;
-    int bracketCounter = 0;
-    std::vector<Graph> temps;
-    std::string current, newExpression;
-    for(unsigned i = 0; validExpression && i < e.size(); i++) {
-        switch(e[i]) {
-            case '(':
-                if(bracketCounter > 0) {
-                    current.push_back(e[i]);
-                }
-                bracketCounter++;
-                break;
-            case ')':
-                bracketCounter--;
-                if(bracketCounter == 0) {
-                    newExpression += ("$" + std::to_string(startIndex + temps.size()));
-                    temps.push_back(parseExpression(current));
-                    current.clear();
+/**
+ * Whether an operand can take long enough to be worth a task: operations and files, but not the graphs that are
+ * already there
+ */
+static bool independent(const Expression& operand) {
+    return operand.type != Expression::VARIABLE && operand.type != Expression::LITERAL &&
+           operand.type != Expression::VALUE;
+}
+
+/**
+ * The operands of a chain that are evaluated on the shared thread pool. There are never more of them than threads,
+ * counting every chain being evaluated, so nested chains run the rest of their operands on the thread that needs them.
+ * Only operands that serial evaluation would reach are started: none after an undefined variable or an invalid
+ * literal, and none after an operand that failed. Tasks that are still running when the chain fails are waited for,
+ * since they read the expression and the session.
+ */
+class GCalc::OperandTasks {
+    std::vector<std::future<SharedGraph>> tasks;
+    std::atomic<size_t> failed; // The first operand whose task threw, or the operand count
+
+    /**
+     * Whether an operand that is already there throws once it is evaluated
+     */
+    static bool fails(const GCalc& calc, const Expression& operand) {
+        if(operand.type == Expression::LITERAL) {
+            return (bool) operand.error;
+        }
+        if(operand.type != Expression::VARIABLE) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(calc.mutex);
+        return calc.variables.count(operand.text) == 0;
+    }
+
+    void fail(size_t i) {
+        size_t first = failed;
+        while(i < first && !failed.compare_exchange_weak(first, i)) {}
+    }
+
+public:
+    OperandTasks(const GCalc& calc, const Expression& chain) :
+            tasks(chain.operands.size()), failed(chain.operands.size()) {
+        for(size_t i = 0; i < chain.operands.size(); i++) {
+            const Expression& operand = *chain.operands[i];
+            if(!independent(operand)) {
+                if(fails(calc, operand)) {
                     break;
                 }
-            default:
-                std::string& toUpdate = (bracketCounter > 0) ? current:newExpression;
-                toUpdate.push_back(e[i]);
+                continue;
+            }
+            if(i == 0 || ++operandTasks >= ThreadPool::threads()) {
+                operandTasks -= i != 0;
+                continue;
+            }
+            tasks[i] = ThreadPool::shared().submit([this, &calc, &operand, i]() -> SharedGraph {
+                if(failed < i) {
+                    operandTasks--;
+                    return nullptr;
+                }
+                try {
+                    SharedGraph value = calc.evaluate(operand);
+                    operandTasks--;
+                    return value;
+                } catch(...) {
+                    fail(i);
+                    operandTasks--;
+                    throw;
+                }
+            });
         }
-        validExpression = bracketCounter >= 0;
     }
-    if(!validExpression) {
-        throw InvalidExpression(e);
+    OperandTasks(const OperandTasks&) = delete;
+    OperandTasks& operator=(const OperandTasks&) = delete;
+
+    ~OperandTasks() {
+        fail(0); // Whatever was not used is not needed, or the chain failed
+        for(std::future<SharedGraph>& task : tasks) {
+            try {
+                if(task.valid()) {
+                    ThreadPool::shared().await(task);
+                }
+            } catch(...) {}
+        }
     }
-    e = newExpression;
-    return temps;
+
+    /**
+     * @return The operand's value, from its task or evaluated now. Errors are thrown in the order of the operands,
+     * as if they were evaluated one after another. A task is only skipped after an operand before it failed, and
+     * that operand throws first.
+     */
+    SharedGraph get(const GCalc& calc, const Expression& chain, size_t i) {
+        return tasks[i].valid() ? ThreadPool::shared().await(tasks[i]) : calc.evaluate(*chain.operands[i]);
+    }
+};
+
+/**
+ * Evaluates a compiled expression into a graph of its own.
+ * A chain is folded into its first operand in place, so only that operand is ever copied.
+ * A run of the same operator is applied in one step, see Graph::uniteWith(), intersectWith() and subtract().
+ * An operand that is itself an operation is evaluated through the cache first, and operands that don't depend on
+ * each other are evaluated meanwhile, see OperandTasks.
+ */
+Graph GCalc::evaluateValue(const Expression& expression) const {
+    switch(expression.type) {
+        case Expression::VARIABLE:
+        case Expression::LITERAL:
+        case Expression::VALUE:
+        case Expression::LOAD:
+            return copyOf(*evaluate(expression));
+        case Expression::IMPORT:
+            return importGraph(expression.text);
+        case Expression::COMPLEMENT: {
+            SharedGraph operand = evaluate(*expression.operands[0]);
+            Clock::time_point start = Clock::now();
+            Graph result = operand->complement();
+            stats.operation('!', secondsSince(start));
+            return result;
+        }
+        case Expression::CHAIN:
+            break;
+    }
+    OperandTasks tasks(*this, expression);
+    const Expression& first = *expression.operands[0];
+    Graph result = first.type == Expression::CHAIN || first.type == Expression::COMPLEMENT ? copyOf(*evaluate(first)) :
+                   evaluateValue(first);
+    for(unsigned i = 1; i < expression.operands.size();) {
+        char op = expression.operators[i - 1];
+        std::vector<SharedGraph> run; // Keeps the operands alive
+        std::vector<const Graph*> operands;
+        do {
+            run.push_back(tasks.get(*this, expression, i++));
+            operands.push_back(run.back().get());
+        } while(i < expression.operands.size() && expression.operators[i - 1] == op);
+        apply(op, result, operands);
+    }
+    return result;
+}
+
+Graph GCalc::copyOf(const Graph& graph) const {
+    stats.copy();
+    return graph;
 }
 
-static Graph& getTemp(std::vector<Graph>& temps, std::string& varName) {
-    assert(varName.front() == '$');
-    varName.erase(0, 1); // Remove $
-    assert(isDigit(varName));
-    int index = std::stoi(varName);
-    assert(index >= 0 && index < temps.size());
-    return temps[index];
+/**
+ * Applies an operator to the left operand in place, timing it
+ * @param g2 The right operands of a run of the operator, in order
+ */
+void GCalc::apply(char op, Graph& g1, const std::vector<const Graph*>& g2) const {
+    Clock::time_point start = Clock::now();
+    operators.at(op)(g1, g2);
+    stats.operation(op, secondsSince(start));
 }
 
-Graph GCalc::parseVariable(std::string& varName, std::vector<Graph>& temps) const {
-    Graph result;
-    bool complement = false;
-    if(varName.front() == COMPLEMENT_OPERATOR)  {
-        complement = true;
-        varName.erase(0, 1);
+/**
+ * @return The value of a variable. A lazy variable is evaluated the first time, and keeps the value.
+ */
+SharedGraph GCalc::valueOf(const std::string& variableName) const {
+    Expression::Ptr plan;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        GET_VARIABLE(iter, variableName);
+        if(iter->second.value) {
+            return iter->second.value;
+        }
+        plan = iter->second.plan;
     }
-    switch(varName.front()) {
-        case '{':
-            result = parseGraph(varName);
-            break;
-        case '$':
-            result = getTemp(temps, varName);
-            break;
-        default:
-            GET_VARIABLE(iter, varName);
-            result = iter->second;
-            break;
+    SharedGraph value = evaluate(*plan);
+    value->settle();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iter = variables.find(variableName);
+        if(iter == variables.end() || iter->second.plan != plan) {
+            return value;
+        }
+        iter->second = {value, nullptr};
     }
-    return complement ? result.complement():result;
-}
-
-static std::vector<Graph> loadFiles(std::string& expression) {
-    std::vector<Graph> temps;
-    std::regex loadFunction("load\\((.*)\\)");
-    auto iter = std::sregex_iterator(expression.begin(), expression.end(), loadFunction);
-    auto endIter = std::sregex_iterator();
-    while(iter != endIter) {
-        expression = expression.substr(0, iter->position(0)) +
-                     "$" +
-                     std::to_string(temps.size()) +
-                     iter->suffix().str();
-        temps.push_back(GCalc::loadGraph(iter->str(1)));
-        iter++;
-    }
-    return temps;
-}
-
-Graph GCalc::parseExpression(std::string& expression) const {
-    bool validExpression = (expression.find('$') == std::string::npos); // Make sure there are no $ signs
-    std::string newExpression = expression;
-    std::vector<Graph> temps(loadFiles(newExpression)), bracketVars(handleBrackets(newExpression, temps.size()));
-    temps.insert(temps.end(), bracketVars.begin(), bracketVars.end());
-    auto nextOperation = operators.begin();
-    Operator currentOperation = nullptr;
-    auto startIter = newExpression.begin();
-    auto endIter = std::find_if(startIter, newExpression.end(),
-                                 [&](const char& c){return (nextOperation = operators.find(c)) != operators.end();});
-    Graph result;
-    while(validExpression) {
-        std::string variableName(startIter, endIter);
-        Graph operand = parseVariable(variableName, temps);
-        result = (currentOperation == nullptr) ? operand:currentOperation(result, operand);
-        if(nextOperation == operators.end()) {
-            break;
+    stats.variable(variableName, value->bytes());
+    return value;
+}
+
+/**
+ * Replaces the variables of an expression with what they hold, so it keeps its meaning once they change.
+ * Files are read right away for the same reason. Errors are thrown in the order evaluation would throw them.
+ */
+Expression::Ptr GCalc::bind(const Expression::Ptr& expression) const {
+    switch(expression->type) {
+        case Expression::VARIABLE: {
+            std::lock_guard<std::mutex> lock(mutex);
+            GET_VARIABLE(iter, expression->text);
+            if(iter->second.plan) {
+                return iter->second.plan;
+            }
+            std::shared_ptr<Expression> value = std::make_shared<Expression>(Expression::VALUE,
+                    expression->text + '#' + std::to_string(versions.at(expression->text)));
+            value->literal = iter->second.value;
+            return value;
         }
-        currentOperation = nextOperation->second;
-        startIter = endIter + 1;
-        endIter = std::find_if(startIter, newExpression.end(),
-                               [&](const char& c){return (nextOperation = operators.find(c)) != operators.end();});
+        case Expression::LITERAL:
+            if(expression->error) {
+                std::rethrow_exception(expression->error);
+            }
+            return expression;
+        case Expression::VALUE:
+            return expression;
+        case Expression::LOAD:
+        case Expression::IMPORT: {
+            std::shared_ptr<Expression> value = std::make_shared<Expression>(Expression::VALUE);
+            value->literal = evaluate(*expression);
+            value->literal->settle();
+            return value;
+        }
+        case Expression::COMPLEMENT:
+        case Expression::CHAIN:
+            break;
     }
-    if(!validExpression) {
-        throw InvalidExpression(expression);
+    std::shared_ptr<Expression> result = std::make_shared<Expression>(*expression);
+    for(Expression::Ptr& operand : result->operands) {
+        operand = bind(operand);
     }
     return result;
 }
 
-void GCalc::parseFunctions(const std::string& command, unsigned long bracket_index) {
+SharedGraph GCalc::parseExpression(const std::string& expression) const {
+    return evaluate(*compile(expression));
+}
+
+void GCalc::parseFunctions(const std::string& command, unsigned long bracket_index, std::ostream& os) {
     std::string func = command.substr(0, bracket_index), params = command.substr(bracket_index + 1);
     params.pop_back(); // Remove end bracket ')'
     if(func == "print") {
-        std::cout << parseExpression(params) << std::endl;
+        printGraph(params, os);
     } else if(func == "delete") {
         deleteGraph(params);
     } else if(func == "save") {
         saveGraph(params);
+    } else if(func == "out" || func == "in") {
+        printAdjacent(params, func == "in", os);
+    } else if(func == "threads") {
+        setThreads(params);
+    } else if(func == "lazy") {
+        setLazy(params);
+    } else if(func == "checkpoint") {
+        checkpoint(params);
+    } else if(func == "restore") {
+        restore(params, os);
+    } else if(func == "journal") {
+        setJournal(params);
     } else {
         throw Graph::GraphException(command, "is not a valid command.");
     }
 }
 
+/**
+ * Turns lazy assignment on or off. Lazy variables keep their simplified expressions, and are only evaluated once
+ * they are printed, saved or otherwise used for more than building another expression.
+ * Turning it off evaluates the variables that are still pending, so later statements see plain values.
+ */
+void GCalc::setLazy(const std::string& mode) {
+    if(mode != "on" && mode != "off") {
+        throw Graph::GraphException(mode, "is not a valid mode.");
+    }
+    lazy = mode == "on";
+    if(lazy) {
+        return;
+    }
+    std::vector<std::string> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(const auto& variable : variables) {
+            if(variable.second.plan) {
+                pending.push_back(variable.first);
+            }
+        }
+    }
+    for(const std::string& name : pending) {
+        valueOf(name);
+    }
+}
+
+/**
+ * Saves every variable in a workspace file, evaluating lazy variables first. The open journal is emptied, since the
+ * file now holds what it recorded.
+ */
+void GCalc::checkpoint(const std::string& fname) {
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(const auto& variable : variables) {
+            names.push_back(variable.first);
+        }
+    }
+    std::vector<SharedGraph> values;
+    std::vector<std::pair<std::string, const Graph*>> graphs;
+    for(const std::string& name : names) {
+        values.push_back(valueOf(name));
+        graphs.emplace_back(name, values.back().get());
+    }
+    try {
+        Graph::saveAll(fname, graphs);
+    } catch(const std::ofstream::failure&) {
+        throw std::invalid_argument("Could not open the file.");
+    }
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if(journal.is_open()) {
+        journal.close();
+        journal.open(journalName, std::ios::trunc);
+    }
+}
+
+/**
+ * Runs 'file' or 'file, journal': replaces every variable with the ones saved in a workspace file, then runs the
+ * statements of the journal. The graphs are read in place from the file, and only copied once they are changed.
+ * The open journal starts over from the restore, followed by the statements it ran, so it doesn't need the journal
+ * it read, which may be itself.
+ */
+void GCalc::restore(const std::string& params, std::ostream& os) {
+    std::vector<std::string> args = arguments(params);
+    if(args.size() > 2) {
+        throw Graph::GraphException(params, "is not a valid checkpoint.");
+    }
+    std::vector<std::string> replay; // Read before any statement runs, since one can restore into the same journal
+    if(args.size() == 2) {
+        std::ifstream file(args[1]);
+        if(!file) {
+            throw std::invalid_argument("Could not open '" + args[1] + "'.");
+        }
+        std::string command;
+        while(std::getline(file, command)) {
+            replay.push_back(stringUtils::removeWhitespace(command));
+        }
+    }
+    std::map<std::string, Variable> values;
+    try {
+        for(std::pair<std::string, Graph>& named : Graph::loadAll(args[0])) {
+            if(!isVariableName(named.first)) {
+                throw Graph::InvalidName(named.first);
+            }
+            values[named.first] = {std::make_shared<Graph>(std::move(named.second)), nullptr};
+        }
+    } catch(const std::ifstream::failure&) {
+        throw std::invalid_argument("Could not open '" + args[0] + "'.");
+    }
+    std::vector<std::string> names;
+    for(const auto& variable : values) {
+        names.push_back(variable.first);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        values.swap(variables);
+        versions.clear();
+    }
+    for(const auto& variable : values) {
+        stats.variable(variable.first, 0);
+    }
+    cache.clear();
+    for(const std::string& name : names) {
+        changed(name);
+    }
+    std::vector<std::string> replayed{"restore(" + args[0] + ")"};
+    for(const std::string& command : replay) {
+        try {
+            if(!command.empty()) {
+                parseCommand(command, os);
+                replayed.push_back(command);
+            }
+        } catch(const std::invalid_argument& e) {
+            os << "Error: " << e.what() << std::endl;
+        }
+    }
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if(journal.is_open()) {
+        journal.close();
+        journal.open(journalName, std::ios::trunc);
+        for(const std::string& command : replayed) {
+            journal << command << '\n';
+        }
+        journal.flush();
+    }
+}
+
+/**
+ * Runs 'file' or 'off'. While a journal is open, every statement that changes variables is appended to it once it
+ * succeeds, so restoring the last checkpoint with the journal brings the variables back.
+ */
+void GCalc::setJournal(const std::string& fname) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    journal.close();
+    journal.clear();
+    journalName.clear();
+    if(fname == "off") {
+        return;
+    }
+    journal.open(fname, std::ios::app);
+    if(!journal) {
+        throw std::invalid_argument("Could not open '" + fname + "'.");
+    }
+    journalName = fname;
+}
+
+/**
+ * Sets how many threads graph operations are split between
+ */
+void GCalc::setThreads(const std::string& count) {
+    if(count.empty() || count.size() > 4 || !std::all_of(count.begin(), count.end(), ::isdigit) || std::stoi(count) == 0) {
+        throw Graph::GraphException(count, "is not a valid thread count.");
+    }
+    ThreadPool::setThreads(std::stoi(count));
+}
+
 void GCalc::assignExpression(const std::string& command, unsigned long equals_index) {
+    if(equals_index > 0 && operators.find(command[equals_index - 1]) != operators.end()) {
+        updateVariable(command, equals_index);
+        return;
+    }
     Node variableName = command.substr(0, equals_index);
-    if(isStatement(variableName) ||
-        isFunction(variableName) ||
-        !isalpha(variableName[0]) ||
-        !std::all_of(variableName.begin() + 1, variableName.end(), isalnum)) {
+    if(!isVariableName(variableName)) {
         throw Graph::InvalidName(variableName);
     }
     std::string expression = command.substr(equals_index + 1);
-    variables[variableName] = parseExpression(expression);
+    if(lazy) {
+        store(variableName, bind(compile(expression)));
+        return;
+    }
+    SharedGraph value = parseExpression(expression);
+    if(value.use_count() == 1) {
+        const_cast<Graph&>(*value).compact(); // A new result that only the variable will hold, cached ones already are
+    }
+    value->settle();
+    Variable assigned = {value, nullptr};
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(assigned, variables[variableName]); // The old value is freed after the lock is released
+    }
+    changed(variableName);
+}
+
+/**
+ * Assigns a bound expression to a variable lazily. Expressions that are too deep or too large to keep are
+ * evaluated now, and so are expressions that simplify to a single graph.
+ */
+void GCalc::store(const std::string& variableName, Expression::Ptr plan) {
+    plan = Expression::simplify(plan);
+    Variable assigned = {nullptr, plan};
+    if(plan->type == Expression::LITERAL || plan->type == Expression::VALUE) {
+        assigned = {plan->literal, nullptr};
+    } else if(plan->size(LAZY_MAX_NODES) > LAZY_MAX_NODES || plan->depth() > LAZY_MAX_DEPTH) {
+        assigned = {evaluate(*plan), nullptr};
+        assigned.value->settle();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::swap(assigned, variables[variableName]);
+    }
+    changed(variableName);
+}
+
+/**
+ * Runs 'G op= expression', which is 'G = G op (expression)' done on G's own graph.
+ * Cached results that are the graph are dropped, and the graph is copied first only if another variable or
+ * expression still shares it.
+ */
+void GCalc::updateVariable(const std::string& command, unsigned long equals_index) {
+    Node variableName = command.substr(0, equals_index - 1);
+    if(lazy) {
+        std::shared_ptr<Expression> plan = std::make_shared<Expression>(Expression::CHAIN);
+        plan->operands.push_back(bind(std::make_shared<Expression>(Expression::VARIABLE, variableName)));
+        plan->operands.push_back(bind(compile(command.substr(equals_index + 1))));
+        plan->operators.push_back(command[equals_index - 1]);
+        store(variableName, plan);
+        return;
+    }
+    valueOf(variableName); // A lazy variable is evaluated before it is changed in place
+    std::map<std::string, Variable>::iterator iter;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        GET_VARIABLE(found, variableName);
+        iter = found; // Stays valid, statements that could erase it run before or after this one
+    }
+    SharedGraph operand = parseExpression(command.substr(equals_index + 1));
+    SharedGraph& value = iter->second.value;
+    if(value.use_count() > 1) {
+        cache.release(value.get()); // The result of the expression the variable was assigned is often cached
+    }
+    if(value.use_count() > 1) {
+        SharedGraph copy = std::make_shared<Graph>(copyOf(*value));
+        std::lock_guard<std::mutex> lock(mutex);
+        value.swap(copy);
+    }
+    size_t before = value->bytes();
+    // Values are created as non-const graphs and this variable is now their only owner
+    apply(command[equals_index - 1], const_cast<Graph&>(*value), {operand.get()});
+    value->settle();
+    stats.allocation(value->bytes() > before ? value->bytes() - before : 0);
+    changed(variableName);
 }
 
-void GCalc::parseCommand(const std::string& command) {
+void GCalc::parseCommand(const std::string& command, std::ostream& os) {
     unsigned long index; // string.find() returns unsigned long instead on int
     auto iter = statements.find(command);
     if(iter != statements.end()) {
-        runStatement(command);
+        runStatement(command, os);
     } else if((index = command.find('=')) != std::string::npos) {
         assignExpression(command, index);
     } else if((index = command.find('(')) !=  std::string::npos && command.rfind(')') == command.length() - 1) {
-        parseFunctions(command, index);
+        parseFunctions(command, index, os);
     } else {
         throw Graph::GraphException(command, "is not a valid command!");
     }
 }
 
+/**
+ * Runs a command, writing its output and its error if it fails to os, and counts the time it took
+ * @param parsed Seconds already spent compiling the command's expressions before it ran
+ */
+void GCalc::execute(const std::string& command, std::ostream& os, double parsed) {
+    double outer = parseSeconds; // Another statement can be waiting on this thread while this one runs
+    parseSeconds = 0;
+    Clock::time_point start = Clock::now();
+    try {
+        parseCommand(command, os);
+        record(command);
+    } catch(const std::invalid_argument& e) {
+        os << "Error: " << e.what() << std::endl;
+    } catch(...) {
+        parseSeconds = outer;
+        throw;
+    }
+    double seconds = secondsSince(start);
+    if(command != "stats" && command != STATS_RESET) {
+        stats.statement(command, parsed + parseSeconds, std::max(seconds - parseSeconds, 0.0));
+    }
+    parseSeconds = outer;
+}
+
+/**
+ * What a statement reads and writes: variable names, and FILES for the file system
+ */
+struct GCalc::Access {
+    std::set<std::string> reads;
+    std::set<std::string> writes;
+    std::set<std::string> loads; // The files the statement loads
+    bool exclusive; // Runs after every statement before it and before every statement after it
+    bool journaled; // Changes variables, so the journal records it once it succeeds
+};
+
+static void collectReads(const Expression& expression, std::set<std::string>& reads, std::set<std::string>& loads) {
+    if(expression.type == Expression::VARIABLE) {
+        reads.insert(expression.text);
+    } else if(expression.type == Expression::LOAD || expression.type == Expression::IMPORT) {
+        reads.insert(FILES);
+    }
+    if(expression.type == Expression::LOAD) {
+        loads.insert(expression.text);
+    }
+    for(const Expression::Ptr& operand : expression.operands) {
+        collectReads(*operand, reads, loads);
+    }
+}
+
+/**
+ * Adds the variables and files an expression reads. An expression that doesn't compile reads nothing,
+ * since evaluating it fails before reading anything.
+ */
+void GCalc::readsOf(const std::string& expression, Access& access) const {
+    try {
+        collectReads(*compile(expression), access.reads, access.loads);
+    } catch(const std::invalid_argument&) {}
+}
+
+/**
+ * Finds what a command accesses, parsing it the same way as parseCommand.
+ * who, reset, checkpoint() and restore() access every variable and in() builds the shared incoming index of a graph,
+ * so they are exclusive, and so is journal() so that the journal starts and stops between statements. threads()
+ * resizes the pool the other statements run on, so it is exclusive too.
+ * Assignments, delete() and reset are journaled. checkpoint() and restore() start the journal over themselves.
+ */
+GCalc::Access GCalc::accessOf(const std::string& command) const {
+    Access access = {{}, {}, {}, false, false};
+    unsigned long index;
+    if(isStatement(command)) {
+        access.exclusive = true;
+        access.journaled = command == "reset";
+    } else if((index = command.find('=')) != std::string::npos) {
+        access.journaled = true;
+        bool update = index > 0 && operators.find(command[index - 1]) != operators.end();
+        access.writes.insert(command.substr(0, update ? index - 1 : index));
+        if(update) {
+            access.reads.insert(command.substr(0, index - 1));
+        }
+        readsOf(command.substr(index + 1), access);
+    } else if((index = command.find('(')) != std::string::npos && command.rfind(')') == command.length() - 1) {
+        std::string func = command.substr(0, index), params = command.substr(index + 1, command.length() - index - 2);
+        if(func == "delete") {
+            access.writes.insert(params);
+            access.journaled = true;
+        } else if(func == "print") {
+            std::vector<std::string> args = arguments(params);
+            readsOf(args.size() == 2 || args.size() == 3 ? args[0] : params, access);
+            if(args.size() == 3) {
+                access.writes.insert(FILES);
+            }
+        } else if(func == "save") {
+            readsOf(arguments(params)[0], access);
+            access.writes.insert(FILES);
+        } else if(func == "out" || func == "in") {
+            readsOf(params.substr(0, params.rfind(',')), access);
+            access.exclusive = func == "in";
+        } else if(func == "lazy" || func == "checkpoint" || func == "restore" || func == "journal" ||
+                  func == "threads") {
+            access.exclusive = true;
+        }
+    }
+    return access;
+}
+
+/**
+ * Appends a command to the journal if it changed variables, as accessOf() finds. Statements that depend on each other
+ * finish in the script's order, so the journal replays to the same variables even when statements run in parallel.
+ */
+void GCalc::record(const std::string& command) {
+    std::lock_guard<std::mutex> lock(journalMutex);
+    if(journal.is_open() && accessOf(command).journaled) {
+        journal << command << '\n';
+        journal.flush();
+    }
+}
+
 std::string GCalc::getCommand() const {
     std::string command;
     if(!ioRedirected) {
@@ -297,16 +1034,151 @@ std::string GCalc::getCommand() const {
     return stringUtils::removeWhitespace(command);
 }
 
-void GCalc::run() {
+/**
+ * Runs a whole script, starting each statement as soon as the statements it depends on are done.
+ * A statement depends on the last statement before it that wrote anything it reads or writes, and on the statements
+ * since then that read what it writes, so every variable sees its statements in the script's order.
+ * The output of each statement is kept until the statements before it have written theirs.
+ */
+void GCalc::runBatch() {
+    struct Task {
+        std::string command;
+        double parsed; // Seconds spent compiling the command to find what it accesses
+        std::ostringstream output;
+        std::exception_ptr error;
+        std::vector<unsigned> dependents;
+        unsigned waiting;
+        std::promise<void> done;
+        std::future<void> finished;
+    };
+    std::vector<Task> tasks;
     std::string command;
     while(std::cin.good() && command != "quit") {
-        try {
+        command = getCommand();
+        if(!command.empty() && command != "quit") {
+            tasks.emplace_back();
+            tasks.back().command = command;
+        }
+    }
+
+    std::map<std::string, unsigned> writers; // The last statement that wrote each variable
+    std::map<std::string, std::vector<unsigned>> readers; // The statements that read each variable since it was written
+    std::vector<unsigned> started; // The statements since the last exclusive one
+    int exclusive = -1;
+    for(unsigned i = 0; i < tasks.size(); i++) {
+        Clock::time_point parsing = Clock::now();
+        Access access = accessOf(tasks[i].command);
+        tasks[i].parsed = secondsSince(parsing);
+        for(const std::string& fname : access.loads) {
+            files.prefetch(fname); // Read while the statements before this one run
+        }
+        std::set<unsigned> dependencies;
+        if(access.exclusive) {
+            dependencies.insert(started.begin(), started.end());
+            writers.clear();
+            readers.clear();
+            started.clear();
+        } else {
+            for(const std::string& name : access.reads) {
+                if(writers.count(name) > 0) {
+                    dependencies.insert(writers[name]);
+                }
+                readers[name].push_back(i);
+            }
+            for(const std::string& name : access.writes) {
+                if(writers.count(name) > 0) {
+                    dependencies.insert(writers[name]);
+                }
+                dependencies.insert(readers[name].begin(), readers[name].end());
+                readers[name].clear();
+                writers[name] = i;
+            }
+        }
+        if(exclusive >= 0) {
+            dependencies.insert(exclusive);
+        }
+        dependencies.erase(i); // Statements that read what they write find themselves among the readers
+        for(unsigned dependency : dependencies) {
+            tasks[dependency].dependents.push_back(i);
+        }
+        tasks[i].waiting = dependencies.size();
+        tasks[i].finished = tasks[i].done.get_future();
+        if(access.exclusive) {
+            exclusive = i;
+        } else {
+            started.push_back(i);
+        }
+    }
+
+    std::mutex scheduling;
+    std::atomic<unsigned> failed(tasks.size()); // The first statement that threw, after which a serial session stops
+    std::function<void(unsigned)> start = [&](unsigned i) {
+        ThreadPool::shared().submit([&, i](){
+            if(i < failed) { // Later statements only release their dependents, so every statement is still done
+                try {
+                    execute(tasks[i].command, tasks[i].output, tasks[i].parsed);
+                } catch(...) {
+                    tasks[i].error = std::current_exception();
+                    unsigned first = failed;
+                    while(i < first && !failed.compare_exchange_weak(first, i)) {}
+                }
+            }
+            std::vector<unsigned> ready;
+            {
+                std::lock_guard<std::mutex> lock(scheduling);
+                for(unsigned dependent : tasks[i].dependents) {
+                    if(--tasks[dependent].waiting == 0) {
+                        ready.push_back(dependent);
+                    }
+                }
+            }
+            for(unsigned dependent : ready) {
+                start(dependent);
+            }
+            tasks[i].done.set_value(); // Last, since the tasks and start() are gone once every statement is done
+        });
+    };
+    std::vector<unsigned> roots; // Found before starting any, since running statements start their dependents
+    for(unsigned i = 0; i < tasks.size(); i++) {
+        if(tasks[i].waiting == 0) {
+            roots.push_back(i);
+        }
+    }
+    for(unsigned i : roots) {
+        start(i);
+    }
+    std::exception_ptr error;
+    for(Task& task : tasks) {
+        ThreadPool::shared().await(task.finished);
+        if(!error) {
+            std::cout << task.output.str();
+            error = task.error;
+        }
+    }
+    std::cout.flush();
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * Runs the session, then writes the counters to the file named by GCALC_STATS, if it is set
+ */
+void GCalc::run() {
+    if(ioRedirected && ThreadPool::threads() > 1) {
+        runBatch();
+    } else {
+        std::string command;
+        while(std::cin.good() && command != "quit") {
             command = getCommand();
             if(!command.empty()) {
-                parseCommand(command);
+                execute(command, std::cout);
             }
-        } catch(const std::invalid_argument& e) {
-            std::cout << "Error: " << e.what() << std::endl;
         }
     }
+    const char* path = std::getenv(STATS_VARIABLE);
+    if(path != nullptr && *path != '\0') {
+        std::ofstream file(path);
+        stats.printJson(file);
+    }
 }
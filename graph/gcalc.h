@@ -2,33 +2,72 @@
 #define GCALC_GCALC_H
 
 
+#include "expression.h"
+#include "fileCache.h"
 #include "graph.h"
+#include "resultCache.h"
+#include "stats.h"
 #include <exception>
 #include <fstream>
 #include <map>
+#include <mutex>
+#include <iostream>
+#include <unordered_map>
 #include <vector>
 
 
 
 class GCalc {
-    std::map<std::string, Graph> variables;
+    struct Variable {
+        SharedGraph value; // Shared, and only modified once no one else holds it. Null until a lazy variable is used.
+        Expression::Ptr plan; // What a lazy variable evaluates to, with the variables it read already bound
+    };
+    mutable std::map<std::string, Variable> variables;
+    mutable std::unordered_map<std::string, Expression::Ptr> plans; // Compiled expressions by their text
+    mutable size_t planBytes; // Memory the plans keep, their texts included
+    std::unordered_map<std::string, uint64_t> versions; // Changes every time the variable is assigned
+    uint64_t lastVersion;
+    bool lazy; // Whether assignments keep their expressions and evaluate them on first use
+    mutable ResultCache cache;
+    mutable FileCache files; // Graphs of load() files, shared between the statements that load them
+    mutable Stats stats;
+    mutable std::mutex mutex; // Guards variables, versions and plans while statements run in parallel
+    std::ofstream journal; // Open while the statements that change variables are journaled
+    std::string journalName;
+    std::mutex journalMutex;
     std::ifstream* const in;
     std::ofstream* const out;
     const bool ioRedirected;
 
-    typedef Graph (*Operator)(const Graph&, const Graph&);
+    // Applies the operator to the left operand in place, with every right operand of a run of the same operator
+    typedef void (*Operator)(Graph&, const std::vector<const Graph*>&);
     static const std::map<char, Operator> operators;
 
+    struct Access;
+    class OperandTasks;
+
     std::string getCommand() const;
-    void parseCommand(const std::string&);
-    void runStatement(const std::string&);
-    void parseFunctions(const std::string&, unsigned long);
+    void execute(const std::string&, std::ostream&, double parsed = 0);
+    void parseCommand(const std::string&, std::ostream&);
+    void runStatement(const std::string&, std::ostream&);
+    void parseFunctions(const std::string&, unsigned long, std::ostream&);
     void assignExpression(const std::string&, unsigned long);
-    static Graph parseGraph(std::string);
-    static std::pair<Node, Node> parseEdge(std::string);
-    std::vector<Graph> handleBrackets(std::string&, unsigned startIndex = 0) const;
-    Graph parseVariable(std::string&, std::vector<Graph>&) const;
-    Graph parseExpression(std::string&) const;
+    void updateVariable(const std::string&, unsigned long);
+    Expression::Ptr compile(const std::string&) const;
+    SharedGraph evaluate(const Expression&) const;
+    SharedGraph valueOf(const std::string&) const;
+    Expression::Ptr bind(const Expression::Ptr&) const;
+    void store(const std::string&, Expression::Ptr);
+    Graph evaluateValue(const Expression&) const;
+    Graph copyOf(const Graph&) const;
+    void apply(char, Graph&, const std::vector<const Graph*>&) const;
+    SharedGraph parseExpression(const std::string&) const;
+    bool cacheKey(const Expression&, std::string&, std::vector<std::string>&) const;
+    void changed(const std::string&);
+    void record(const std::string&);
+    Access accessOf(const std::string&) const;
+    void readsOf(const std::string&, Access&) const;
+    void runBatch();
 
 public:
     class InvalidExpression : public Graph::GraphException {
@@ -45,8 +84,18 @@ public:
     ~GCalc();
 
     void saveGraph(const std::string& params) const;
-    static Graph loadGraph(const std::string& params);
-    void printVariables() const;
+    SharedGraph loadGraph(const std::string& params) const;
+    static Graph importGraph(const std::string& params);
+    void printGraph(const std::string& params, std::ostream& os = std::cout) const;
+    void printAdjacent(const std::string& params, bool incoming, std::ostream& os = std::cout) const;
+    static void setThreads(const std::string& count);
+    void setLazy(const std::string& mode);
+    void checkpoint(const std::string& fname);
+    void restore(const std::string& params, std::ostream& os = std::cout);
+    void setJournal(const std::string& fname);
+    void printVariables(std::ostream& os = std::cout) const;
+    void printCache(std::ostream& os = std::cout) const;
+    void printStats(std::ostream& os = std::cout) const;
     void deleteGraph(std::string& params);
     void run();
 
@@ -1,14 +1,21 @@
 #include "graph.h"
+#include "graphFile.h"
+#include "packedFile.h"
+#include "threadPool.h"
 #include <algorithm>
 #include <cctype>
+#include <cstring>
+#include <deque>
 #include <fstream>
-using Edge = Graph::Edge;
+#include <functional>
 
-template<class T>
-static bool contains(const std::set<T>& set, const T& element) {
-    // std::set doesn't have contains function in C++11
-    return set.find(element) != set.cend();
-}
+#define DENSE_MIN_NODES 64
+#define DENSE_RATIO 32 // A bit matrix is smaller than the rows once 1 in 32 pairs are edges
+#define ERASED_SHARE 2 // Nodes are renumbered once more than 1 in 2 ids are erased
+#define PRINT_BUFFER_BYTES (1 << 20) // Printed graphs are written to their stream in blocks of this size
+#define EDGE_LIST_MAGIC "GCALCEL1"
+
+using Edge = Graph::Edge;
 
 Edge::Edge(const Node& s, const Node& d) : src(s), dest(d) {}
 
@@ -46,27 +53,266 @@ Graph::GraphException::GraphException(const std::string& lit,
 Graph::InvalidName::InvalidName(const std::string& name) : GraphException(name, "is not a valid variable name.") {}
 Graph::NodeNotFound::NodeNotFound(const std::string& node) : GraphException(node, "is not in the graph.") {}
 
-Graph::Graph(std::set<Node>& n, std::set<Edge>& e) : nodes(n), edges(e) {}
-Graph::Graph(std::set<Node>&& n, std::set<Edge>&& e) : nodes(n), edges(e) {}
+Graph::NodeView::const_iterator::const_iterator(const SymbolTable* t, NodeId i) : table(t), id(i) {
+    while(id < table->bound() && !table->alive(id)) {
+        id++;
+    }
+}
+
+Node Graph::NodeView::const_iterator::operator*() const {
+    return table->name(id);
+}
+
+Graph::NodeView::const_iterator& Graph::NodeView::const_iterator::operator++() {
+    *this = const_iterator(table, id + 1);
+    return *this;
+}
 
-Graph::Graph() : Graph(std::set<Node>(), std::set<Edge>()) {}
-Graph::Graph(const Graph& g) : Graph(std::set<Node>(g.nodes), std::set<Edge>(g.edges)) {}
-Graph::Graph(Graph&& g) noexcept : Graph(g.nodes, g.edges) {}
+bool Graph::NodeView::const_iterator::operator==(const const_iterator& other) const {
+    return table == other.table && id == other.id;
+}
+
+bool Graph::NodeView::const_iterator::operator!=(const const_iterator& other) const {
+    return !(*this == other);
+}
+
+Graph::NodeView::NodeView(const SymbolTable* t) : table(t) {}
+
+Graph::NodeView::const_iterator Graph::NodeView::begin() const {
+    return const_iterator(table, 0);
+}
+
+Graph::NodeView::const_iterator Graph::NodeView::end() const {
+    return const_iterator(table, table->bound());
+}
+
+Graph::NodeView::const_iterator Graph::NodeView::find(const Node& n) const {
+    NodeId id = table->find(n);
+    return id == SymbolTable::NONE ? end() : const_iterator(table, id);
+}
+
+size_t Graph::NodeView::size() const {
+    return table->size();
+}
+
+bool Graph::NodeView::empty() const {
+    return size() == 0;
+}
+
+Graph::Graph() : symbols(), outgoing(), incoming(), incomingIndexed(false), pending(), dense(), isDense(false) {}
+Graph::Graph(const Graph& g) : symbols(g.symbols), outgoing(g.outgoing), incoming(g.incoming),
+                               incomingIndexed(g.incomingIndexed), pending(g.pending), dense(g.dense), isDense(g.isDense) {}
+Graph::Graph(Graph&& g) noexcept : symbols(std::move(g.symbols)), outgoing(std::move(g.outgoing)),
+                                   incoming(std::move(g.incoming)), incomingIndexed(g.incomingIndexed),
+                                   pending(std::move(g.pending)), dense(std::move(g.dense)), isDense(g.isDense) {
+    g.clearAll(); // Leave g as a valid empty graph, which allocates nothing until it is changed
+}
 
 Graph& Graph::operator=(const Graph& other) {
     if(this != &other) {
-        nodes.clear();
-        edges.clear();
-        nodes.insert(other.nodes.begin(), other.nodes.end());
-        edges.insert(other.edges.begin(), other.edges.end());
+        symbols = other.symbols;
+        outgoing = other.outgoing;
+        incoming = other.incoming;
+        incomingIndexed = other.incomingIndexed;
+        pending = other.pending;
+        dense = other.dense;
+        isDense = other.isDense;
     }
     return *this;
 }
 
+Graph& Graph::operator=(Graph&& other) noexcept {
+    if(this != &other) {
+        symbols = std::move(other.symbols);
+        outgoing = std::move(other.outgoing);
+        incoming = std::move(other.incoming);
+        incomingIndexed = other.incomingIndexed;
+        pending = std::move(other.pending);
+        dense = std::move(other.dense);
+        isDense = other.isDense;
+        other.clearAll();
+    }
+    return *this;
+}
+
+/**
+ * Merges the edges added since the last flush into the sorted rows
+ */
+void Graph::flush() const {
+    if(isDense) {
+        return; // Dense edges are written in place
+    }
+    if(!pending.empty()) {
+        std::vector<EdgeKey> keys;
+        pending.appendTo(keys);
+        pending.clear();
+        outgoing.merge(keys);
+        if(incomingIndexed) {
+            std::transform(keys.begin(), keys.end(), keys.begin(), reversedKey);
+            incoming.merge(keys);
+        }
+    }
+    if(outgoing.rows() < symbols.bound()) {
+        outgoing.resize(symbols.bound());
+    }
+    if(incomingIndexed && incoming.rows() < symbols.bound()) {
+        incoming.resize(symbols.bound());
+    }
+}
+
+/**
+ * Merges the edges added since the last flush. Until the graph is modified again, const reads of it other than
+ * predecessors() don't modify it, so it can be read by several threads at once.
+ */
+void Graph::settle() const {
+    flush();
+}
+
+/**
+ * Settles the graph and indexes the sources of every node, so until it is modified again no const read modifies it,
+ * predecessors() included
+ */
+void Graph::freeze() const {
+    flush();
+    if(!isDense) {
+        indexIncoming();
+    }
+}
+
+/**
+ * Merges the pending edges, renumbers the nodes without the erased ids and frees the room the arrays grew into but
+ * don't use, for graphs that are kept
+ */
+void Graph::compact() {
+    renumber();
+    outgoing.compact();
+    incoming.compact();
+}
+
+/**
+ * @return About how much memory the graph takes, counting arrays read from a mapped file
+ */
+size_t Graph::bytes() const {
+    return sizeof(Graph) + symbols.bytes() + outgoing.bytes() + incoming.bytes() + dense.bytes() +
+           pending.bytes();
+}
+
+void Graph::indexIncoming() const {
+    flush();
+    if(!incomingIndexed) {
+        incoming = outgoing.transposed();
+        incomingIndexed = true;
+    }
+}
+
+/**
+ * Calls f with every target of u in increasing id order, whichever layout holds the edges.
+ * Pending edges are not visited.
+ */
+template<class F>
+void Graph::forEachTarget(NodeId u, F f) const {
+    if(isDense) {
+        dense.forEach(u, f);
+    } else {
+        std::for_each(outgoing.begin(u), outgoing.end(u), f);
+    }
+}
+
+bool Graph::hasEdge(NodeId src, NodeId dest) const {
+    return isDense ? dense.contains(src, dest) : outgoing.contains(src, dest);
+}
+
+std::set<Node> Graph::targetNames(NodeId u) const {
+    std::set<Node> out;
+    forEachTarget(u, [&](NodeId v){out.insert(symbols.name(v));});
+    return out;
+}
+
+Adjacency Graph::sparseCopy() const {
+    if(!isDense) {
+        return outgoing;
+    }
+    std::vector<EdgeKey> keys;
+    keys.reserve(dense.edges());
+    for(NodeId u = 0; u < dense.rows(); u++) {
+        dense.forEach(u, [&](NodeId v){keys.push_back(edgeKey(u, v));});
+    }
+    return Adjacency(symbols.bound(), keys);
+}
+
+DenseAdjacency Graph::denseCopy() const {
+    if(isDense) {
+        return dense;
+    }
+    DenseAdjacency out(symbols.bound());
+    for(NodeId u = 0; u < outgoing.rows(); u++) {
+        for(const NodeId* v = outgoing.begin(u); v != outgoing.end(u); v++) {
+            out.insert(u, *v);
+        }
+    }
+    return out;
+}
+
+/**
+ * @return A bit for every id, set if the id is in use
+ */
+std::vector<uint64_t> Graph::liveMask() const {
+    std::vector<uint64_t> mask((symbols.bound() + 63) / 64, 0);
+    for(NodeId id = 0; id < symbols.bound(); id++) {
+        if(symbols.alive(id)) {
+            mask[id / 64] |= (uint64_t) 1 << (id % 64);
+        }
+    }
+    return mask;
+}
+
+/**
+ * Moves the edges to the layout that suits their density.
+ * A graph turns dense once a bit matrix is smaller than its rows, and turns sparse again at half that density,
+ * so a graph near the threshold doesn't change layout on every operation.
+ */
+void Graph::pickLayout() {
+    reclaimErased();
+    flush();
+    uint64_t cells = (uint64_t) symbols.bound() * symbols.bound();
+    if(!isDense && symbols.bound() >= DENSE_MIN_NODES && edgeCount() * DENSE_RATIO >= cells) {
+        makeDense();
+    } else if(isDense && edgeCount() * DENSE_RATIO * 2 < cells) {
+        makeSparse();
+    }
+}
+
+void Graph::makeDense() {
+    flush();
+    dense = denseCopy();
+    outgoing = Adjacency();
+    incoming = Adjacency();
+    incomingIndexed = false;
+    isDense = true;
+}
+
+void Graph::makeSparse() {
+    outgoing = sparseCopy();
+    dense = DenseAdjacency();
+    isDense = false;
+}
+
+NodeId Graph::idOf(const Node& n) const {
+    NodeId id = symbols.find(n);
+    if(id == SymbolTable::NONE) {
+        throw NodeNotFound(n);
+    }
+    return id;
+}
+
 bool Graph::validNode(const std::string& name) {
+    return validNode(name.data(), name.size());
+}
+
+bool Graph::validNode(const char* name, size_t length) {
     bool isValid = true;
     int bracketCounter = 0;
-    for(int i = 0; isValid && i < (int) name.size(); i++) {
+    for(size_t i = 0; isValid && i < length; i++) {
         char c = name[i];
         switch(c) {
             case '[':
@@ -90,77 +336,242 @@ void Graph::addNode(const Node& n) {
     if(!validNode(n)) {
         throw InvalidName(n);
     }
-    nodes.insert(n);
+    symbols.intern(n);
+    if(isDense) {
+        dense.resize(symbols.bound());
+    }
 }
 
 void Graph::removeNode(const Node& n) {
-    nodes.erase(n);
+    NodeId id = symbols.find(n);
+    if(id == SymbolTable::NONE) {
+        return;
+    }
+    if(isDense) {
+        dense.clearRow(id);
+        dense.clearColumn(id);
+    } else {
+        indexIncoming();
+        for(const NodeId* u = incoming.begin(id); u != incoming.end(id); u++) {
+            outgoing.erase(*u, id);
+        }
+        for(const NodeId* v = outgoing.begin(id); v != outgoing.end(id); v++) {
+            incoming.erase(*v, id);
+        }
+        outgoing.clearRow(id);
+        incoming.clearRow(id);
+    }
+    symbols.erase(id);
+    reclaimErased();
 }
 
 bool Graph::containsNode(const Node& n) const {
-    return contains(nodes, n);
+    return symbols.find(n) != SymbolTable::NONE;
 }
 
 bool Graph::adjacent(const Node& n1, const Node& n2) const {
-    if(!contains(nodes, n1)) {
-        throw NodeNotFound(n1);
-    } else if(!contains(nodes, n2)) {
-        throw NodeNotFound(n2);
-    }
-    return contains(edges, Edge(n1, n2));
+    NodeId src = idOf(n1), dest = idOf(n2);
+    return hasEdge(src, dest) || pending.contains(edgeKey(src, dest));
 }
 
 std::set<Node> Graph::neighbours(const Node& n) const {
-    if(!contains(nodes, n)) {
-        throw NodeNotFound(n);
-    }
+    NodeId id = idOf(n);
+    flush();
+    return targetNames(id);
+}
+
+std::set<Node> Graph::predecessors(const Node& n) const {
+    NodeId id = idOf(n);
     std::set<Node> out;
-    for(const Edge& e : edges) {
-        if(e.src == n) {
-            out.insert(e.dest);
+    if(isDense) {
+        for(NodeId u = 0; u < dense.rows(); u++) {
+            if(dense.contains(u, id)) {
+                out.insert(symbols.name(u));
+            }
         }
+        return out;
+    }
+    indexIncoming();
+    for(const NodeId* u = incoming.begin(id); u != incoming.end(id); u++) {
+        out.insert(symbols.name(*u));
     }
     return out;
 }
 
+uint64_t Graph::edgeCount() const {
+    return isDense ? dense.edges() : outgoing.edges() + pending.size();
+}
+
 void Graph::clearEdges() {
-    edges.clear();
+    outgoing = symbols.bound() == 0 ? Adjacency() : Adjacency(symbols.bound());
+    incoming = Adjacency();
+    incomingIndexed = false;
+    pending.clear();
+    dense = DenseAdjacency();
+    isDense = false;
 }
 
 void Graph::clearAll() {
-    nodes.clear();
+    symbols.clear();
     clearEdges();
 }
 
-const std::set<Node>& Graph::getNodes() const {
-    return nodes;
+Graph::NodeView Graph::getNodes() const {
+    return NodeView(&symbols);
 }
 
-static inline void binaryWriteUint(unsigned int num, std::ofstream& os) {
-    os.write((const char*) &num, sizeof(unsigned int));
+/**
+ * Lists the targets of a row ordered by their names
+ * @param rank The sorted position of each node's name
+ */
+void Graph::sortedTargets(NodeId u, const std::vector<NodeId>& rank, std::vector<NodeId>& out) const {
+    out.clear();
+    forEachTarget(u, [&](NodeId v){out.push_back(v);});
+    std::sort(out.begin(), out.end(), [&rank](NodeId a, NodeId b){return rank[a] < rank[b];});
 }
 
-static void binaryWriteStr(const std::string& str, std::ofstream& os) {
-    binaryWriteUint(str.size(), os);
-    os.write(str.c_str(), str.size());
+/**
+ * Writes the graph in the format described in graphFile.h. A dense graph is written as rows.
+ */
+void Graph::save(const std::string& fname) const {
+    flush();
+    Adjacency copy;
+    const Adjacency& rows = isDense ? (copy = sparseCopy()) : outgoing;
+    GraphWriter writer;
+    symbols.save(writer);
+    rows.save(writer);
+    writer.write(fname);
 }
 
-void Graph::save(const std::string& fname) const {
-    std::ofstream graphFile(fname, std::ios::binary);
-    binaryWriteUint(nodes.size(), graphFile);
-    binaryWriteUint(edges.size(), graphFile);
-    for(const Node& n : nodes) {
-        binaryWriteStr(n, graphFile);
+/**
+ * Writes the graph in the packed format described in packedFile.h, which is smaller than a graph file but has to be
+ * unpacked when it is loaded
+ * @param compress Whether the blocks are also compressed with zlib
+ */
+void Graph::archive(const std::string& fname, bool compress) const {
+    flush();
+    std::vector<NodeId> order = symbols.sorted(), rank = symbols.ranks(order);
+    packedFile::write(fname, (NodeId) order.size(), [&](NodeId i, std::string& name, std::vector<NodeId>& targets) {
+        name.assign(symbols.data(order[i]), symbols.length(order[i]));
+        sortedTargets(order[i], rank, targets);
+        for(NodeId& target : targets) {
+            target = rank[target];
+        }
+    }, compress);
+}
+
+/**
+ * Loads a graph file. Files in the current format are mapped and read in place, without parsing or checking the nodes
+ * or edges, so only the sizes of their arrays are checked; verify() checks the rest. The graph copies the mapped arrays
+ * only once it is modified. Packed files are recognized and unpacked in parallel.
+ */
+Graph Graph::load(const std::string& fname) {
+    std::shared_ptr<const MappedFile> file = std::make_shared<MappedFile>(fname);
+    if(packedFile::recognizes(*file)) {
+        Graph result;
+        std::vector<std::vector<EdgeKey>> runs;
+        packedFile::read(*file, fname, result.symbols, runs);
+        result.outgoing = Adjacency(result.symbols.bound(), runs);
+        result.pickLayout();
+        return result;
     }
-    for(const Edge& e : edges) {
-        binaryWriteStr(e.src, graphFile);
-        binaryWriteStr(e.dest, graphFile);
+    if(!GraphReader::recognizes(*file)) {
+        return loadLegacy(fname);
     }
-    graphFile.close();
+    GraphReader reader(file, fname);
+    Graph result;
+    result.symbols = SymbolTable(reader);
+    result.outgoing = Adjacency(reader);
+    reader.check(result.outgoing.rows() == result.symbols.bound());
+    return result;
+}
+
+/**
+ * Saves named graphs in a single workspace file, each laid out the way save() lays out a graph
+ * @param graphs The names have to be distinct
+ */
+void Graph::saveAll(const std::string& fname, const std::vector<std::pair<std::string, const Graph*>>& graphs) {
+    GraphWriter writer(WORKSPACE_FILE_MAGIC);
+    SymbolTable names;
+    for(const auto& named : graphs) {
+        names.intern(named.first);
+    }
+    names.save(writer);
+    std::deque<Adjacency> copies; // The sparse rows of dense graphs, which the writer only points to
+    for(const auto& named : graphs) {
+        const Graph& graph = *named.second;
+        graph.flush();
+        graph.symbols.save(writer);
+        if(graph.isDense) {
+            copies.push_back(graph.sparseCopy());
+        }
+        (graph.isDense ? copies.back() : graph.outgoing).save(writer);
+    }
+    writer.write(fname);
+}
+
+/**
+ * Loads every graph of a workspace file, mapped and read in place like load() reads a graph file
+ * @return The graphs in the order they were saved, with their names
+ */
+std::vector<std::pair<std::string, Graph>> Graph::loadAll(const std::string& fname) {
+    std::shared_ptr<const MappedFile> file = std::make_shared<MappedFile>(fname);
+    GraphReader reader(file, fname, WORKSPACE_FILE_MAGIC);
+    SymbolTable names(reader);
+    std::vector<std::pair<std::string, Graph>> result(names.bound());
+    for(NodeId id = 0; id < names.bound(); id++) {
+        result[id].first.assign(names.data(id), names.length(id));
+        Graph& graph = result[id].second;
+        graph.symbols = SymbolTable(reader);
+        graph.outgoing = Adjacency(reader);
+        reader.check(graph.outgoing.rows() == graph.symbols.bound());
+    }
+    return result;
+}
+
+/**
+ * Checks a file in the current format against the checksums of its sections and checks every index in it, which load()
+ * both skips
+ */
+bool Graph::verify(const std::string& fname) {
+    GraphReader reader(std::make_shared<MappedFile>(fname), fname);
+    try {
+        SymbolTable symbols(reader);
+        Adjacency outgoing(reader);
+        reader.check(outgoing.rows() == symbols.bound());
+        symbols.check(reader);
+        outgoing.check(reader);
+    } catch(const GraphException&) {
+        return false;
+    }
+    return reader.verify();
+}
+
+/**
+ * Builds a graph from a text edge list, see edgeList::read()
+ */
+Graph Graph::import(const std::string& fname, ImportStats& stats) {
+    SymbolTable symbols;
+    std::vector<EdgeKey> keys;
+    edgeList::read(fname, symbols, keys, stats);
+    return build(std::move(symbols), keys);
+}
+
+/**
+ * Builds a graph from its nodes and its edges at once
+ * @param keys The edges between the nodes, in any order and possibly repeated. Sorted and deduplicated in place.
+ */
+Graph Graph::build(SymbolTable&& symbols, std::vector<EdgeKey>& keys) {
+    Graph result;
+    result.symbols = std::move(symbols);
+    result.outgoing.resize(result.symbols.bound());
+    result.outgoing.merge(keys);
+    result.pickLayout();
+    return result;
 }
 
 static unsigned int binaryReadUint(std::ifstream& is) {
-    unsigned int out;
+    unsigned int out = 0;
     is.read((char*) &out, sizeof(unsigned int));
     return out;
 }
@@ -173,119 +584,746 @@ static std::string binaryReadStr(std::ifstream& is) {
     return result;
 }
 
-Graph Graph::load(const std::string& fname) {
+/**
+ * Reads the headerless format of older versions: the node and edge counts, then every name as a length and
+ * its characters
+ */
+Graph Graph::loadLegacy(const std::string& fname) {
     std::ifstream graphFile(fname, std::ios::binary);
     Graph result;
     unsigned int vertexNum = binaryReadUint(graphFile), edgeNum = binaryReadUint(graphFile);
     for(unsigned int i = 0; i < vertexNum; i++) {
         result.addNode(binaryReadStr(graphFile));
     }
+    std::vector<EdgeKey> keys;
+    keys.reserve(edgeNum);
     for(unsigned int i = 0; i < edgeNum; i++) {
-        result.addEdge(binaryReadStr(graphFile), binaryReadStr(graphFile));
+        Node src = binaryReadStr(graphFile), dest = binaryReadStr(graphFile);
+        keys.push_back(result.validEdge(src, dest));
     }
     graphFile.close();
+    result.outgoing.resize(result.symbols.bound());
+    result.outgoing.merge(keys);
+    result.pickLayout();
     return result;
 }
 
-void Graph::addEdge(const Edge& e) {
-    if(e.src == e.dest) {
+/**
+ * Checks that an edge can be added to the graph
+ * @return The edge's key
+ */
+EdgeKey Graph::validEdge(const Node& src, const Node& dest) const {
+    if(src == dest) {
         throw Graph::Edge::EdgeError("A node cannot be connected to itself.");
-    } else if(!contains(nodes, e.src)) {
-        throw NodeNotFound(e.src);
-    } else if(!contains(nodes, e.dest)) {
-        throw NodeNotFound(e.dest);
     }
-    edges.insert(e);
+    NodeId srcId = idOf(src), destId = idOf(dest);
+    return edgeKey(srcId, destId);
+}
+
+void Graph::addEdge(const Edge& e) {
+    addEdge(e.src, e.dest);
 }
 
 void Graph::addEdge(const Node& src, const Node& dest) {
-    addEdge(Edge(src, dest));
+    EdgeKey key = validEdge(src, dest);
+    if(isDense) {
+        dense.insert(keySrc(key), keyDest(key));
+    } else if(!outgoing.contains(keySrc(key), keyDest(key))) {
+        pending.insert(key);
+    }
+}
+
+/**
+ * Adds the edges of a batch at once. The edges are sorted and merged into the rows instead of being added one by one.
+ * @param keys Sorted and deduplicated in place
+ */
+void Graph::mergeKeys(std::vector<EdgeKey>& keys) {
+    if(isDense) {
+        dense.resize(symbols.bound());
+        for(EdgeKey key : keys) {
+            dense.insert(keySrc(key), keyDest(key));
+        }
+    } else {
+        flush();
+        outgoing.merge(keys);
+        if(incomingIndexed) {
+            std::transform(keys.begin(), keys.end(), keys.begin(), reversedKey);
+            incoming.merge(keys);
+        }
+    }
+    pickLayout();
+}
+
+/**
+ * Adds several nodes. Nothing is added if one of the names is invalid.
+ */
+void Graph::addNodes(const std::vector<Node>& nodes) {
+    for(const Node& n : nodes) {
+        if(!validNode(n)) {
+            throw InvalidName(n);
+        }
+    }
+    for(const Node& n : nodes) {
+        symbols.intern(n);
+    }
+    if(isDense) {
+        dense.resize(symbols.bound());
+    }
+}
+
+/**
+ * Adds several edges between existing nodes. Nothing is added if one of the edges is invalid.
+ */
+void Graph::addEdges(const std::vector<std::pair<Node, Node>>& edges) {
+    std::vector<EdgeKey> keys;
+    keys.reserve(edges.size());
+    for(const std::pair<Node, Node>& e : edges) {
+        keys.push_back(validEdge(e.first, e.second));
+    }
+    mergeKeys(keys);
+}
+
+/**
+ * Adds the nodes and edges of a text edge list held in memory, see edgeList::read().
+ * Nodes that are new to the graph are added too. Nothing is added if the text is invalid.
+ */
+void Graph::addEdgeList(const char* text, size_t length) {
+    SymbolTable names;
+    std::vector<EdgeKey> keys;
+    ImportStats stats;
+    edgeList::parse(text, length, names, keys, stats);
+    std::vector<NodeId> map(names.bound());
+    for(NodeId id = 0; id < names.bound(); id++) {
+        map[id] = symbols.intern(names.data(id), names.length(id));
+    }
+    for(EdgeKey& key : keys) {
+        key = edgeKey(map[keySrc(key)], map[keyDest(key)]);
+    }
+    mergeKeys(keys);
+}
+
+/**
+ * @return Every edge, ordered by the names of its source and then its target
+ */
+std::vector<std::pair<Node, Node>> Graph::edges() const {
+    flush();
+    std::vector<NodeId> order = symbols.sorted(), rank = symbols.ranks(order), row;
+    std::vector<std::pair<Node, Node>> result;
+    result.reserve(edgeCount());
+    for(NodeId src : order) {
+        sortedTargets(src, rank, row);
+        for(NodeId dest : row) {
+            result.emplace_back(Node(symbols.data(src), symbols.length(src)),
+                                Node(symbols.data(dest), symbols.length(dest)));
+        }
+    }
+    return result;
 }
 
 void Graph::removeEdge(const Edge& e) {
-    edges.erase(e);
+    removeEdge(e.src, e.dest);
 }
 
 void Graph::removeEdge(const Node& src, const Node& dest) {
-    removeEdge(Edge(src, dest));
+    NodeId srcId = symbols.find(src), destId = symbols.find(dest);
+    if(srcId == SymbolTable::NONE || destId == SymbolTable::NONE) {
+        return;
+    }
+    if(isDense) {
+        dense.erase(srcId, destId);
+    } else if(!pending.erase(edgeKey(srcId, destId))) {
+        outgoing.erase(srcId, destId);
+        if(incomingIndexed) {
+            incoming.erase(destId, srcId);
+        }
+    }
+}
+
+/**
+ * Builds the edges of a subgraph whose ids were assigned in increasing order of the source ids,
+ * so the keys come out sorted and the rows can be built directly. The rows are split between threads.
+ * @param map The id of every source node in the subgraph, or NONE if it was left out
+ * @param keep Decides whether an edge between two kept nodes is in the subgraph
+ */
+template<class Predicate>
+static Adjacency inducedEdges(const Adjacency& source, const std::vector<NodeId>& map, NodeId rows, Predicate keep) {
+    std::vector<std::vector<EdgeKey>> runs(ThreadPool::threads());
+    ThreadPool::parallelFor(source.rows(), [&source](size_t u){return source.offset(u);}, [&](unsigned part, size_t first, size_t last) {
+        for(NodeId u = first; u < last; u++) {
+            if(map[u] == SymbolTable::NONE) {
+                continue;
+            }
+            for(const NodeId* v = source.begin(u); v != source.end(u); v++) {
+                if(map[*v] != SymbolTable::NONE && keep(u, *v)) {
+                    runs[part].push_back(edgeKey(map[u], map[*v]));
+                }
+            }
+        }
+    });
+    return Adjacency(rows, runs);
+}
+
+/**
+ * Gives the live nodes consecutive ids in the order of their old ids, so erased ids no longer take room in the rows
+ * or in the bit matrix
+ */
+void Graph::renumber() {
+    flush();
+    std::vector<NodeId> map = symbols.compact();
+    if(map.size() == symbols.bound()) {
+        return; // No id was erased
+    }
+    if(isDense) {
+        DenseAdjacency rows(symbols.bound());
+        for(NodeId u = 0; u < dense.rows(); u++) {
+            if(map[u] != SymbolTable::NONE) {
+                dense.forEach(u, [&](NodeId v){rows.insert(map[u], map[v]);});
+            }
+        }
+        dense = std::move(rows);
+    } else {
+        outgoing = inducedEdges(outgoing, map, symbols.bound(), [](NodeId, NodeId){return true;});
+        incoming = Adjacency();
+        incomingIndexed = false;
+    }
+}
+
+/**
+ * Renumbers the nodes once most ids are erased, so a graph that keeps losing and gaining nodes doesn't keep growing
+ */
+void Graph::reclaimErased() {
+    if((uint64_t) symbols.erased() * ERASED_SHARE > symbols.bound()) {
+        renumber();
+    }
+}
+
+/**
+ * Calls f with every row of a bit matrix, splitting the rows between threads
+ */
+template<class F>
+static void forEachRow(NodeId rows, size_t words, F f) {
+    ThreadPool::parallelFor(rows, [words](size_t u){return (uint64_t) u * words;}, [&f](unsigned, size_t first, size_t last) {
+        for(NodeId u = first; u < last; u++) {
+            f(u);
+        }
+    });
+}
+
+/**
+ * Adds the nodes and edges of g. Nodes that are new to this graph get ids after the existing ones.
+ */
+void Graph::uniteWith(const Graph& g) {
+    if(&g == this) {
+        return;
+    }
+    flush();
+    g.flush();
+    std::vector<NodeId> map(g.symbols.bound(), SymbolTable::NONE);
+    bool aligned = true; // Whether every node of g has the same id here
+    for(NodeId id = 0; id < g.symbols.bound(); id++) {
+        if(g.symbols.alive(id)) {
+            map[id] = symbols.intern(g.symbols.data(id), g.symbols.length(id));
+            aligned = aligned && map[id] == id;
+        }
+    }
+    if(aligned && (isDense || g.isDense)) {
+        if(!isDense) {
+            makeDense();
+        }
+        dense.resize(symbols.bound());
+        // Ids of g past the end of this graph can only be unused, so their rows and columns are empty
+        NodeId rows = std::min(symbols.bound(), g.symbols.bound());
+        if(g.isDense) {
+            size_t words = std::min(dense.words(), g.dense.words());
+            forEachRow(rows, words, [&](NodeId u){
+                DenseAdjacency::unite(dense.row(u), dense.row(u), g.dense.row(u), words);
+            });
+        } else {
+            for(NodeId u = 0; u < rows; u++) {
+                g.forEachTarget(u, [&](NodeId v){dense.insert(u, v);});
+            }
+        }
+        dense.recount();
+    } else if(isDense) {
+        dense.resize(symbols.bound());
+        for(NodeId u = 0; u < g.symbols.bound(); u++) {
+            g.forEachTarget(u, [&](NodeId v){dense.insert(map[u], map[v]);});
+        }
+    } else {
+        std::vector<EdgeKey> keys;
+        keys.reserve(g.edgeCount());
+        for(NodeId u = 0; u < g.symbols.bound(); u++) {
+            g.forEachTarget(u, [&](NodeId v){keys.push_back(edgeKey(map[u], map[v]));});
+        }
+        flush();
+        outgoing.merge(keys);
+        if(incomingIndexed) {
+            std::transform(keys.begin(), keys.end(), keys.begin(), reversedKey);
+            incoming.merge(keys);
+        }
+    }
+    pickLayout();
+}
+
+/**
+ * Adds the nodes and edges of every graph of a list. The edges of all the sparse graphs are merged into the rows
+ * at once, so a long chain of unions rebuilds the rows once instead of once per graph.
+ */
+void Graph::uniteWith(const std::vector<const Graph*>& graphs) {
+    std::vector<EdgeKey> keys;
+    std::vector<NodeId> map;
+    for(const Graph* g : graphs) {
+        if(g == this) {
+            continue;
+        }
+        if(isDense || g->isDense) {
+            uniteWith(*g); // Dense rows are already combined a word at a time
+            continue;
+        }
+        g->flush();
+        map.assign(g->symbols.bound(), SymbolTable::NONE);
+        for(NodeId id = 0; id < g->symbols.bound(); id++) {
+            if(g->symbols.alive(id)) {
+                map[id] = symbols.intern(g->symbols.data(id), g->symbols.length(id));
+            }
+        }
+        for(NodeId u = 0; u < g->symbols.bound(); u++) {
+            g->forEachTarget(u, [&](NodeId v){keys.push_back(edgeKey(map[u], map[v]));});
+        }
+    }
+    mergeKeys(keys);
+}
+
+/**
+ * Keeps the nodes that are also in g and the edges between them that are also in g.
+ * Nodes keep their ids, the ones that are left out become unused.
+ */
+void Graph::intersectWith(const Graph& g) {
+    if(&g == this) {
+        return;
+    }
+    flush();
+    g.flush();
+    std::vector<NodeId> other(symbols.bound(), SymbolTable::NONE);
+    bool aligned = g.isDense; // Whether every common node has the same id in g
+    for(NodeId id = 0; id < symbols.bound(); id++) {
+        if(symbols.alive(id)) {
+            other[id] = g.symbols.find(symbols.data(id), symbols.length(id));
+            if(other[id] == SymbolTable::NONE) {
+                symbols.erase(id);
+            }
+        }
+        aligned = aligned && (other[id] == SymbolTable::NONE || other[id] == id);
+    }
+    if(isDense) {
+        restrictDense(liveMask());
+        if(aligned) {
+            size_t words = std::min(dense.words(), g.dense.words());
+            forEachRow(dense.rows(), dense.words(), [&](NodeId u){
+                if(other[u] != SymbolTable::NONE) {
+                    DenseAdjacency::intersect(dense.row(u), dense.row(u), g.dense.row(u), words);
+                    std::fill(dense.row(u) + words, dense.row(u) + dense.words(), 0);
+                }
+            });
+        } else {
+            for(NodeId u = 0; u < dense.rows(); u++) {
+                dense.forEach(u, [&](NodeId v){
+                    if(!g.hasEdge(other[u], other[v])) {
+                        dense.erase(u, v);
+                    }
+                });
+            }
+        }
+        dense.recount();
+    } else {
+        std::vector<NodeId> kept(symbols.bound(), SymbolTable::NONE);
+        for(NodeId id = 0; id < symbols.bound(); id++) {
+            kept[id] = symbols.alive(id) ? id : SymbolTable::NONE;
+        }
+        outgoing = inducedEdges(outgoing, kept, symbols.bound(),
+                                [&](NodeId u, NodeId v){return g.hasEdge(other[u], other[v]);});
+        incoming = Adjacency();
+        incomingIndexed = false;
+    }
+    pickLayout();
+}
+
+/**
+ * Keeps the nodes and edges that are in every graph of a list, rebuilding the rows once instead of once per graph
+ */
+void Graph::intersectWith(const std::vector<const Graph*>& graphs) {
+    std::vector<const Graph*> others;
+    bool dense = isDense;
+    for(const Graph* g : graphs) {
+        if(g != this) {
+            others.push_back(g);
+            dense = dense || g->isDense;
+        }
+    }
+    if(dense || others.size() < 2) {
+        for(const Graph* g : others) {
+            intersectWith(*g); // Dense rows are already combined a word at a time
+        }
+        return;
+    }
+    flush();
+    // The id of every node in each of the other graphs
+    std::vector<std::vector<NodeId>> other(others.size(), std::vector<NodeId>(symbols.bound(), SymbolTable::NONE));
+    std::vector<NodeId> kept(symbols.bound(), SymbolTable::NONE);
+    for(NodeId id = 0; id < symbols.bound(); id++) {
+        if(!symbols.alive(id)) {
+            continue;
+        }
+        bool found = true;
+        for(size_t k = 0; found && k < others.size(); k++) {
+            other[k][id] = others[k]->symbols.find(symbols.data(id), symbols.length(id));
+            found = other[k][id] != SymbolTable::NONE;
+        }
+        if(found) {
+            kept[id] = id;
+        } else {
+            symbols.erase(id);
+        }
+    }
+    for(const Graph* g : others) {
+        g->flush();
+    }
+    outgoing = inducedEdges(outgoing, kept, symbols.bound(), [&](NodeId u, NodeId v) {
+        for(size_t k = 0; k < others.size(); k++) {
+            if(!others[k]->hasEdge(other[k][u], other[k][v])) {
+                return false;
+            }
+        }
+        return true;
+    });
+    incoming = Adjacency();
+    incomingIndexed = false;
+    pickLayout();
+}
+
+/**
+ * Removes the nodes that are in g, along with their edges.
+ * The remaining nodes keep their ids.
+ */
+void Graph::subtract(const Graph& g) {
+    subtract(std::vector<const Graph*>{&g});
+}
+
+/**
+ * Removes the nodes that are in any graph of a list, along with their edges, as if the graphs were united first.
+ * The edges are rebuilt once. The remaining nodes keep their ids.
+ */
+void Graph::subtract(const std::vector<const Graph*>& graphs) {
+    if(std::find(graphs.begin(), graphs.end(), this) != graphs.end()) {
+        clearAll();
+        return;
+    }
+    flush();
+    bool removed = false;
+    for(NodeId id = 0; id < symbols.bound(); id++) {
+        if(!symbols.alive(id)) {
+            continue;
+        }
+        for(const Graph* g : graphs) {
+            if(g->symbols.find(symbols.data(id), symbols.length(id)) != SymbolTable::NONE) {
+                symbols.erase(id);
+                removed = true;
+                break;
+            }
+        }
+    }
+    if(!removed) {
+        return;
+    }
+    if(isDense) {
+        restrictDense(liveMask());
+    } else {
+        std::vector<NodeId> kept(symbols.bound(), SymbolTable::NONE);
+        for(NodeId id = 0; id < symbols.bound(); id++) {
+            kept[id] = symbols.alive(id) ? id : SymbolTable::NONE;
+        }
+        outgoing = inducedEdges(outgoing, kept, symbols.bound(), [](NodeId, NodeId){return true;});
+        incoming = Adjacency();
+        incomingIndexed = false;
+    }
+    pickLayout();
 }
 
 Graph Graph::unite(const Graph& g1, const Graph& g2) {
-    Graph out;
-    std::set_union(g1.nodes.begin(), g1.nodes.end(),
-                   g2.nodes.begin(), g2.nodes.end(),
-                   std::inserter(out.nodes, out.nodes.end()));
-    std::set_union(g1.edges.begin(), g1.edges.end(),
-                   g2.edges.begin(), g2.edges.end(),
-                   std::inserter(out.edges, out.edges.end()));
+    Graph out(g1);
+    out.uniteWith(g2);
     return out;
 }
 
+/**
+ * Restricts a dense graph to the nodes in a mask, keeping the ids of the nodes that remain
+ */
+void Graph::restrictDense(const std::vector<uint64_t>& mask) {
+    forEachRow(dense.rows(), dense.words(), [&](NodeId u){
+        if((mask[u / 64] >> (u % 64)) & 1) {
+            DenseAdjacency::intersect(dense.row(u), dense.row(u), mask.data(), dense.words());
+        } else {
+            std::fill(dense.row(u), dense.row(u) + dense.words(), 0);
+        }
+    });
+    dense.recount();
+}
+
 Graph Graph::intersection(const Graph& g1, const Graph& g2) {
+    if(g1.isDense) {
+        // The rows are combined in g1's id space, so nodes that are left out become unused ids
+        Graph out(g1);
+        out.intersectWith(g2);
+        return out;
+    }
+    g1.flush();
+    g2.flush();
     Graph out;
-    std::set_intersection(g1.nodes.begin(), g1.nodes.end(),
-                          g2.nodes.begin(), g2.nodes.end(),
-                          std::inserter(out.nodes, out.nodes.end()));
-    std::set_intersection(g1.edges.begin(), g1.edges.end(),
-                          g2.edges.begin(), g2.edges.end(),
-                          std::inserter(out.edges, out.edges.end()));
+    std::vector<NodeId> other(g1.symbols.bound(), SymbolTable::NONE), map(g1.symbols.bound(), SymbolTable::NONE);
+    for(NodeId id = 0; id < g1.symbols.bound(); id++) {
+        if(g1.symbols.alive(id)) {
+            other[id] = g2.symbols.find(g1.symbols.data(id), g1.symbols.length(id));
+        }
+        if(other[id] != SymbolTable::NONE) {
+            map[id] = out.symbols.intern(g1.symbols.data(id), g1.symbols.length(id));
+        }
+    }
+    out.outgoing = inducedEdges(g1.outgoing, map, out.symbols.bound(),
+                                [&](NodeId u, NodeId v){return g2.hasEdge(other[u], other[v]);});
+    out.pickLayout();
     return out;
 }
 
 Graph Graph::difference(const Graph& g1, const Graph& g2) {
+    if(g1.isDense) {
+        Graph out(g1);
+        out.subtract(g2);
+        return out;
+    }
+    g1.flush();
     Graph out;
-    std::set_difference(g1.nodes.begin(), g1.nodes.end(),
-                        g2.nodes.begin(), g2.nodes.end(),
-                        std::inserter(out.nodes, out.nodes.end()));
-    std::copy_if(g1.edges.begin(), g1.edges.end(),
-                 std::inserter(out.edges, out.edges.end()),
-                 [&](const Edge& e){return contains(out.nodes, e.src) && contains(out.nodes, e.dest);});
+    std::vector<NodeId> map(g1.symbols.bound(), SymbolTable::NONE);
+    for(NodeId id = 0; id < g1.symbols.bound(); id++) {
+        if(g1.symbols.alive(id) && g2.symbols.find(g1.symbols.data(id), g1.symbols.length(id)) == SymbolTable::NONE) {
+            map[id] = out.symbols.intern(g1.symbols.data(id), g1.symbols.length(id));
+        }
+    }
+    out.outgoing = inducedEdges(g1.outgoing, map, out.symbols.bound(), [](NodeId, NodeId){return true;});
+    out.pickLayout();
     return out;
 }
 
-Node Graph::nodeProduct(const Node& n1, const Node& n2) {
-    return "[" + n1 + ";" + n2 + "]";
+/**
+ * @return The live ids in increasing order
+ */
+static std::vector<NodeId> liveIds(const SymbolTable& symbols) {
+    std::vector<NodeId> out;
+    out.reserve(symbols.size());
+    for(NodeId id = 0; id < symbols.bound(); id++) {
+        if(symbols.alive(id)) {
+            out.push_back(id);
+        }
+    }
+    return out;
 }
 
 Graph Graph::product(const Graph& g1, const Graph& g2) {
+    g1.flush();
+    g2.flush();
     Graph out;
-    for(const Node& n1 : g1.nodes) {
-        for(const Node& n2 : g2.nodes) {
-            out.addNode(nodeProduct(n1, n2));
-        }
+    Adjacency copy1, copy2;
+    const Adjacency& rows1 = g1.isDense ? (copy1 = g1.sparseCopy()) : g1.outgoing;
+    const Adjacency& rows2 = g2.isDense ? (copy2 = g2.sparseCopy()) : g2.outgoing;
+    std::vector<NodeId> ids1 = liveIds(g1.symbols), ids2 = liveIds(g2.symbols);
+    // The names are only written when they are needed, products of products don't write the inner ones at all.
+    // Throws before the ids below can wrap around.
+    out.symbols = SymbolTable::product(g1.symbols, ids1, g2.symbols, ids2);
+    // Product node (i, j) gets id i * |V2| + j, so both the ids and the edge keys come out in order
+    std::vector<NodeId> index1(g1.symbols.bound()), index2(g2.symbols.bound());
+    for(NodeId i = 0; i < (NodeId) ids1.size(); i++) {
+        index1[ids1[i]] = i;
     }
-    for(const Edge& e1: g1.edges) {
-        for(const Edge& e2: g2.edges) {
-            out.addEdge(Edge(nodeProduct(e1.src, e2.src), nodeProduct(e1.dest, e2.dest)));
+    for(NodeId j = 0; j < (NodeId) ids2.size(); j++) {
+        index2[ids2[j]] = j;
+    }
+    NodeId width = ids2.size();
+    std::vector<EdgeKey> keys;
+    keys.reserve(rows1.edges() * rows2.edges());
+    for(NodeId u1 : ids1) {
+        for(NodeId u2 : ids2) {
+            NodeId src = index1[u1] * width + index2[u2];
+            for(const NodeId* v1 = rows1.begin(u1); v1 != rows1.end(u1); v1++) {
+                for(const NodeId* v2 = rows2.begin(u2); v2 != rows2.end(u2); v2++) {
+                    keys.push_back(edgeKey(src, index1[*v1] * width + index2[*v2]));
+                }
+            }
         }
     }
+    out.outgoing = Adjacency(out.symbols.bound(), keys);
+    out.pickLayout();
     return out;
 }
 
 Graph Graph::complement() const {
+    flush();
     Graph out;
-    out.nodes.insert(nodes.begin(), nodes.end());
-    for (auto i = nodes.begin(); i != nodes.end(); i++) {
-        for (auto j = nodes.begin(); j != nodes.end(); j++) {
-            if (i == j) {
-                continue;
+    out.symbols = symbols;
+    if(isDense || symbols.bound() >= DENSE_MIN_NODES) {
+        // Every row becomes the live nodes minus the row, then the node itself is taken out
+        DenseAdjacency copy;
+        const DenseAdjacency& rows = isDense ? dense : (copy = denseCopy());
+        std::vector<uint64_t> live = liveMask();
+        out.dense = DenseAdjacency(symbols.bound());
+        out.isDense = true;
+        forEachRow(symbols.bound(), out.dense.words(), [&](NodeId u){
+            if(symbols.alive(u)) {
+                DenseAdjacency::subtract(out.dense.row(u), live.data(), rows.row(u), out.dense.words());
+                out.dense.row(u)[u / 64] &= ~((uint64_t) 1 << (u % 64));
             }
-            Edge e(*i, *j);
-            if (!contains(edges, e)) {
-                out.addEdge(e);
+        });
+        out.dense.recount();
+    } else {
+        std::vector<EdgeKey> keys;
+        std::vector<NodeId> ids = liveIds(symbols);
+        for(NodeId u : ids) {
+            const NodeId* row = outgoing.begin(u);
+            const NodeId* rowEnd = outgoing.end(u);
+            for(NodeId v : ids) {
+                while(row != rowEnd && *row < v) {
+                    row++;
+                }
+                if(v != u && (row == rowEnd || *row != v)) {
+                    keys.push_back(edgeKey(u, v));
+                }
             }
         }
+        out.outgoing = Adjacency(out.symbols.bound(), keys);
     }
+    out.pickLayout();
     return out;
 }
 
-std::ostream& operator<<(std::ostream& os, const Graph& graph) {
-    for(const Node& node : graph.nodes) {
-        os << node << std::endl;
+/**
+ * Collects output and writes it to a stream in large blocks, without ever flushing the stream
+ */
+class OutputBuffer {
+    std::ostream& os;
+    std::string buffer;
+
+public:
+    explicit OutputBuffer(std::ostream& o) : os(o), buffer() {
+        buffer.reserve(PRINT_BUFFER_BYTES);
+    }
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer() {
+        write();
+    }
+
+    void write() {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void append(const char* str, size_t length) {
+        buffer.append(str, length);
+        if(buffer.size() >= PRINT_BUFFER_BYTES) {
+            write();
+        }
     }
-    os << "$";
-    for(const Edge& edge : graph.edges) {
-        os << std::endl << edge;
+
+    void append(const char* str) {
+        append(str, std::strlen(str));
     }
+
+    template<class T>
+    void appendBytes(T value) {
+        append((const char*) &value, sizeof(T));
+    }
+};
+
+/**
+ * Prints the graph in one of the formats described in graph.h
+ */
+void Graph::write(std::ostream& os, Format format) const {
+    flush();
+    std::vector<NodeId> order = symbols.sorted(), rank = symbols.ranks(order), row;
+    OutputBuffer out(os);
+    auto name = [&](NodeId id){out.append(symbols.data(id), symbols.length(id));};
+    auto forEachEdge = [&](const std::function<void(NodeId, NodeId)>& f) {
+        for(NodeId src : order) {
+            sortedTargets(src, rank, row);
+            for(NodeId dest : row) {
+                f(src, dest);
+            }
+        }
+    };
+    switch(format) {
+        case TEXT:
+            for(NodeId node : order) {
+                name(node);
+                out.append("\n");
+            }
+            out.append("$");
+            forEachEdge([&](NodeId src, NodeId dest) {
+                out.append("\n");
+                name(src);
+                out.append(" ");
+                name(dest);
+            });
+            break;
+        case EDGE_LIST: {
+            std::vector<bool> linked(symbols.bound(), false);
+            for(NodeId src : order) {
+                forEachTarget(src, [&](NodeId dest){linked[src] = linked[dest] = true;});
+            }
+            for(NodeId node : order) {
+                if(!linked[node]) {
+                    name(node);
+                    out.append("\n");
+                }
+            }
+            forEachEdge([&](NodeId src, NodeId dest) {
+                name(src);
+                out.append(" ");
+                name(dest);
+                out.append("\n");
+            });
+            break;
+        }
+        case DOT:
+            out.append("digraph G {\n");
+            for(NodeId node : order) {
+                out.append("    \"");
+                name(node);
+                out.append("\";\n");
+            }
+            forEachEdge([&](NodeId src, NodeId dest) {
+                out.append("    \"");
+                name(src);
+                out.append("\" -> \"");
+                name(dest);
+                out.append("\";\n");
+            });
+            out.append("}\n");
+            break;
+        case BINARY:
+            out.append(EDGE_LIST_MAGIC);
+            out.appendBytes((uint32_t) order.size());
+            out.appendBytes((uint64_t) edgeCount());
+            for(NodeId node : order) {
+                out.appendBytes((uint32_t) symbols.length(node));
+                name(node);
+            }
+            forEachEdge([&](NodeId src, NodeId dest) {
+                out.appendBytes((uint32_t) rank[src]);
+                out.appendBytes((uint32_t) rank[dest]);
+            });
+            break;
+    }
+}
+
+std::ostream& operator<<(std::ostream& os, const Graph& graph) {
+    graph.write(os, Graph::TEXT);
     return os;
 }
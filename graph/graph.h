@@ -1,9 +1,16 @@
 #ifndef GCALC_GRAPH_H
 #define GCALC_GRAPH_H
+#include "adjacency.h"
+#include "denseAdjacency.h"
+#include "edgeList.h"
+#include "keySet.h"
+#include "symbolTable.h"
 #include <exception>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <set>
+#include <utility>
 #include <vector>
 
 typedef std::string Node;
@@ -46,12 +53,70 @@ public:
         };
     };
 
+    /**
+     * Read only view of the nodes of a graph, iterated in insertion order
+     */
+    class NodeView {
+        const SymbolTable* table;
+    public:
+        class const_iterator {
+            const SymbolTable* table;
+            NodeId id;
+        public:
+            const_iterator(const SymbolTable*, NodeId);
+            Node operator*() const;
+            const_iterator& operator++();
+            bool operator==(const const_iterator&) const;
+            bool operator!=(const const_iterator&) const;
+        };
+
+        explicit NodeView(const SymbolTable*);
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator find(const Node&) const;
+        size_t size() const;
+        bool empty() const;
+    };
+
+    /**
+     * Ways to print a graph. Nodes and edges are always in the order of the node names.
+     *     TEXT       the nodes one per line, then '$', then an edge per line as the two names. No final newline.
+     *     EDGE_LIST  the nodes without edges one per line, then an edge per line, as import() reads them
+     *     DOT        a Graphviz digraph
+     *     BINARY     "GCALCEL1", the node count (32 bits) and edge count (64 bits), every name as its length
+     *                (32 bits) and characters, then every edge as the indices of its nodes in that list (32 bits each).
+     *                Numbers are in the byte order of the machine that wrote them.
+     */
+    enum Format {TEXT, EDGE_LIST, DOT, BINARY};
+
 private:
-    std::set<Node> nodes;
-    std::set<Edge> edges;
-    Graph(std::set<Node>&, std::set<Edge>&);
-    Graph(std::set<Node>&&, std::set<Edge>&&);
-    static Node nodeProduct(const Node&, const Node&);
+    SymbolTable symbols;
+    mutable Adjacency outgoing;
+    mutable Adjacency incoming; // Built on first use, then kept in sync with outgoing
+    mutable bool incomingIndexed;
+    mutable KeySet pending; // Edges added since the last flush
+    DenseAdjacency dense; // Holds the edges instead of outgoing while isDense is set
+    bool isDense;
+    void flush() const;
+    void indexIncoming() const;
+    template<class F>
+    void forEachTarget(NodeId, F) const;
+    bool hasEdge(NodeId, NodeId) const;
+    std::set<Node> targetNames(NodeId) const;
+    void sortedTargets(NodeId, const std::vector<NodeId>&, std::vector<NodeId>&) const;
+    Adjacency sparseCopy() const;
+    DenseAdjacency denseCopy() const;
+    std::vector<uint64_t> liveMask() const;
+    void restrictDense(const std::vector<uint64_t>&);
+    void makeDense();
+    void makeSparse();
+    void pickLayout();
+    void renumber();
+    void reclaimErased();
+    void mergeKeys(std::vector<EdgeKey>&);
+    NodeId idOf(const Node&) const;
+    EdgeKey validEdge(const Node&, const Node&) const;
+    static Graph loadLegacy(const std::string& fname);
 
 public:
     Graph();
@@ -60,22 +125,47 @@ public:
     ~Graph() = default;
 
     Graph& operator=(const Graph&);
+    Graph& operator=(Graph&&) noexcept;
     static bool validNode(const std::string&);
+    static bool validNode(const char*, size_t);
     void addNode(const Node&);
+    void addNodes(const std::vector<Node>&);
     void clearEdges();
     void clearAll();
     void removeNode(const Node&);
     bool containsNode(const Node&) const;
     bool adjacent(const Node&, const Node&) const;
     std::set<Node> neighbours(const Node&) const;
-    const std::set<Node>& getNodes() const;
+    std::set<Node> predecessors(const Node&) const;
+    uint64_t edgeCount() const;
+    NodeView getNodes() const;
+    void settle() const;
+    void freeze() const;
+    void compact();
+    size_t bytes() const;
     void save(const std::string& fname) const;
+    void archive(const std::string& fname, bool compress = false) const;
+    void write(std::ostream&, Format) const;
     static Graph load(const std::string& fname);
+    static void saveAll(const std::string& fname, const std::vector<std::pair<std::string, const Graph*>>& graphs);
+    static std::vector<std::pair<std::string, Graph>> loadAll(const std::string& fname);
+    static bool verify(const std::string& fname);
+    static Graph import(const std::string& fname, ImportStats& stats);
+    static Graph build(SymbolTable&& symbols, std::vector<EdgeKey>& keys);
     void addEdge(const Edge&);
     void removeEdge(const Edge&);
     void addEdge(const Node&, const Node&);
+    void addEdges(const std::vector<std::pair<Node, Node>>&);
+    void addEdgeList(const char* text, size_t length);
+    std::vector<std::pair<Node, Node>> edges() const;
     void removeEdge(const Node&, const Node&);
     Graph complement() const;
+    void uniteWith(const Graph&);
+    void intersectWith(const Graph&);
+    void subtract(const Graph&);
+    void uniteWith(const std::vector<const Graph*>&);
+    void intersectWith(const std::vector<const Graph*>&);
+    void subtract(const std::vector<const Graph*>&);
     friend std::ostream& operator<<(std::ostream&, const Graph&);
     static Graph unite(const Graph&, const Graph&);
     static Graph intersection(const Graph&, const Graph&);
@@ -85,4 +175,6 @@ public:
 
 std::ostream& operator<<(std::ostream&, const Graph::Edge&);
 
+typedef std::shared_ptr<const Graph> SharedGraph; // Immutable graph value that can be shared without copying
+
 #endif //GCALC_GRAPH_H
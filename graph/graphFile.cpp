@@ -0,0 +1,171 @@
+#include "graphFile.h"
+#include "graph.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BYTE_ORDER_MARK 0x01020304
+#define SECTION_ALIGNMENT 64
+
+struct FileHeader {
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint32_t sections;
+    uint32_t reserved;
+};
+
+struct SectionEntry {
+    uint64_t offset;
+    uint64_t count;
+    uint64_t width;
+    uint64_t checksum;
+};
+
+/**
+ * 64 bit FNV-1a over whole words, with a shift to mix the high bits back in
+ */
+static uint64_t checksum(const char* data, size_t bytes) {
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < bytes; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, std::min<size_t>(8, bytes - i));
+        h = (h ^ word) * 1099511628211ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+static uint64_t aligned(uint64_t offset) {
+    return (offset + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+MappedFile::MappedFile(const std::string& fname) : bytes(nullptr), length(0) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    struct stat info;
+    if(fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        throw std::ifstream::failure("Could not open '" + fname + "'.");
+    }
+    length = info.st_size;
+    if(length > 0) {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if(mapping == MAP_FAILED) {
+            close(fd);
+            throw std::ifstream::failure("Could not map '" + fname + "'.");
+        }
+        bytes = (const char*) mapping;
+    }
+    close(fd); // The mapping stays valid without the descriptor
+}
+
+MappedFile::~MappedFile() {
+    if(bytes != nullptr) {
+        munmap((void*) bytes, length);
+    }
+}
+
+GraphWriter::GraphWriter(const char* m) : sections(), magic(m) {}
+
+/**
+ * Writes the file next to its destination and renames it into place, so graphs still mapped from an older file
+ * with the same name keep reading the old contents
+ */
+void GraphWriter::write(const std::string& fname) const {
+    FileHeader header;
+    std::memcpy(header.magic, magic, sizeof(header.magic));
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.version = GRAPH_FILE_VERSION;
+    header.sections = sections.size();
+    header.reserved = 0;
+    std::vector<SectionEntry> table(sections.size());
+    uint64_t offset = aligned(sizeof(FileHeader) + table.size() * sizeof(SectionEntry) + sizeof(uint64_t));
+    for(unsigned i = 0; i < sections.size(); i++) {
+        uint64_t bytes = sections[i].count * sections[i].width;
+        table[i] = {offset, sections[i].count, sections[i].width, checksum(sections[i].data, bytes)};
+        offset = aligned(offset + bytes);
+    }
+    std::string head((const char*) &header, sizeof(header));
+    head.append((const char*) table.data(), table.size() * sizeof(SectionEntry));
+    uint64_t tableChecksum = checksum(head.data(), head.size());
+    head.append((const char*) &tableChecksum, sizeof(tableChecksum));
+
+    std::string temporary = fname + ".tmp";
+    std::ofstream graphFile(temporary, std::ios::binary);
+    if(!graphFile) {
+        throw std::ofstream::failure("Could not open '" + fname + "'.");
+    }
+    const char padding[SECTION_ALIGNMENT] = {};
+    graphFile.write(head.data(), head.size());
+    uint64_t written = head.size();
+    for(unsigned i = 0; i < sections.size(); i++) {
+        graphFile.write(padding, table[i].offset - written);
+        graphFile.write(sections[i].data, table[i].count * table[i].width);
+        written = table[i].offset + table[i].count * table[i].width;
+    }
+    graphFile.close();
+    if(!graphFile || std::rename(temporary.c_str(), fname.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::ofstream::failure("Could not write '" + fname + "'.");
+    }
+}
+
+/**
+ * Checks the header and the section table. The sections themselves are only checked by verify().
+ */
+GraphReader::GraphReader(std::shared_ptr<const MappedFile> f, const std::string& fname, const char* magic) :
+        file(std::move(f)), name(fname), table(nullptr), count(0), next(0) {
+    check(recognizes(*file, magic));
+    const FileHeader* header = (const FileHeader*) file->data();
+    check(header->byteOrder == BYTE_ORDER_MARK && header->version == GRAPH_FILE_VERSION);
+    uint64_t tableBytes = (uint64_t) header->sections * sizeof(SectionEntry);
+    check(sizeof(FileHeader) + tableBytes + sizeof(uint64_t) <= file->size());
+    uint64_t tableChecksum;
+    std::memcpy(&tableChecksum, file->data() + sizeof(FileHeader) + tableBytes, sizeof(tableChecksum));
+    check(tableChecksum == checksum(file->data(), sizeof(FileHeader) + tableBytes));
+    table = (const SectionEntry*) (file->data() + sizeof(FileHeader));
+    count = header->sections;
+    for(uint32_t i = 0; i < count; i++) {
+        const SectionEntry& entry = table[i];
+        check(entry.offset % SECTION_ALIGNMENT == 0 && entry.width > 0 && entry.offset <= file->size() &&
+              entry.count <= (file->size() - entry.offset) / entry.width);
+    }
+}
+
+bool GraphReader::recognizes(const MappedFile& f, const char* magic) {
+    return f.size() >= sizeof(FileHeader) && std::memcmp(f.data(), magic, 8) == 0;
+}
+
+/**
+ * Throws if a condition on the file's contents doesn't hold
+ */
+void GraphReader::check(bool condition) const {
+    if(!condition) {
+        throw Graph::GraphException(name, "is not a valid graph file.");
+    }
+}
+
+/**
+ * @return Whether every section still matches its checksum
+ */
+bool GraphReader::verify() const {
+    for(uint32_t i = 0; i < count; i++) {
+        if(checksum(file->data() + table[i].offset, table[i].count * table[i].width) != table[i].checksum) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* GraphReader::section(uint32_t width, uint64_t& elements) {
+    check(next < count && table[next].width == width);
+    elements = table[next].count;
+    return file->data() + table[next++].offset;
+}
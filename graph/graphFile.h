@@ -0,0 +1,103 @@
+#ifndef GCALC_GRAPHFILE_H
+#define GCALC_GRAPHFILE_H
+#include "buffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Graph file layout, version 1. All numbers are in the byte order of the machine that wrote the file.
+ *     header    magic, byte order mark, version, section count
+ *     table     offset, element count, element width and checksum of every section, then the table's own checksum
+ *     sections  the raw arrays of the graph, each starting on a 64 byte boundary
+ * The arrays are the graph's in-memory representation, so a mapped file can be read in place.
+ * A workspace file has the same layout with its own magic: the names of its graphs, then the sections of each graph.
+ */
+#define GRAPH_FILE_MAGIC "GCALCGRF"
+#define WORKSPACE_FILE_MAGIC "GCALCWSP"
+#define GRAPH_FILE_VERSION 1
+
+/**
+ * A whole file mapped read only. The mapping is shared, so processes that load the same file share its pages.
+ */
+class MappedFile {
+    const char* bytes;
+    size_t length;
+
+public:
+    explicit MappedFile(const std::string& fname);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const {return bytes;}
+    size_t size() const {return length;}
+};
+
+class GraphWriter {
+    struct Section {
+        const char* data;
+        uint64_t count;
+        uint32_t width;
+    };
+    std::vector<Section> sections;
+    const char* magic;
+
+public:
+    explicit GraphWriter(const char* magic = GRAPH_FILE_MAGIC);
+
+    /**
+     * Adds an array as the next section. The elements are not copied, so they must outlive the writer.
+     */
+    template<class T>
+    void add(const T* elements, size_t count) {
+        sections.push_back({(const char*) elements, count, sizeof(T)});
+    }
+
+    template<class T>
+    void add(const Buffer<T>& buffer) {
+        add(buffer.data(), buffer.size());
+    }
+
+    void write(const std::string& fname) const;
+};
+
+struct SectionEntry;
+
+/**
+ * Reads the sections of a mapped graph file in the order they were written, without copying them
+ */
+class GraphReader {
+    std::shared_ptr<const MappedFile> file;
+    std::string name;
+    const SectionEntry* table;
+    uint32_t count;
+    uint32_t next;
+
+    const char* section(uint32_t width, uint64_t& elements);
+
+public:
+    GraphReader(std::shared_ptr<const MappedFile>, const std::string& fname, const char* magic = GRAPH_FILE_MAGIC);
+
+    static bool recognizes(const MappedFile&, const char* magic = GRAPH_FILE_MAGIC);
+    void check(bool) const;
+    bool verify() const;
+
+    template<class T>
+    Buffer<T> read() {
+        uint64_t elements;
+        const T* first = (const T*) section(sizeof(T), elements);
+        return Buffer<T>(file, first, elements);
+    }
+
+    template<class T>
+    T value() {
+        uint64_t elements;
+        const T* first = (const T*) section(sizeof(T), elements);
+        check(elements == 1);
+        return *first;
+    }
+};
+
+#endif //GCALC_GRAPHFILE_H
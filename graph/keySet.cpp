@@ -0,0 +1,99 @@
+#include "keySet.h"
+
+#define MIN_KEY_SLOTS 16
+
+const EdgeKey KeySet::EMPTY;
+
+KeySet::KeySet() : slots(MIN_KEY_SLOTS, EMPTY), count(0) {}
+
+size_t KeySet::hash(EdgeKey key) {
+    // Finalizer of splitmix64, consecutive targets of a node land far apart
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return (size_t) (key ^ (key >> 31));
+}
+
+/**
+ * @return The slot holding the key, or the empty slot where it would be inserted
+ */
+size_t KeySet::slotOf(EdgeKey key) const {
+    size_t mask = slots.size() - 1;
+    for(size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+        if(slots[i] == key || slots[i] == EMPTY) {
+            return i;
+        }
+    }
+}
+
+void KeySet::rehash(size_t slotCount) {
+    std::vector<EdgeKey> old(slotCount, EMPTY);
+    old.swap(slots);
+    size_t mask = slotCount - 1;
+    for(EdgeKey key : old) {
+        if(key == EMPTY) {
+            continue;
+        }
+        size_t i = hash(key) & mask;
+        while(slots[i] != EMPTY) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = key;
+    }
+}
+
+/**
+ * @return Whether the key was new
+ */
+bool KeySet::insert(EdgeKey key) {
+    size_t i = slotOf(key);
+    if(slots[i] == key) {
+        return false;
+    }
+    if(2 * (count + 1) > slots.size()) { // Keep the table at most half full
+        rehash(2 * slots.size());
+        i = slotOf(key);
+    }
+    slots[i] = key;
+    count++;
+    return true;
+}
+
+/**
+ * @return Whether the key was in the set
+ */
+bool KeySet::erase(EdgeKey key) {
+    size_t mask = slots.size() - 1;
+    size_t hole = slotOf(key);
+    if(slots[hole] != key) {
+        return false;
+    }
+    // Moves back every key whose home slot is not between the hole and the key, so its probe still reaches it
+    for(size_t i = (hole + 1) & mask; slots[i] != EMPTY; i = (i + 1) & mask) {
+        size_t home = hash(slots[i]) & mask;
+        if(((i - home) & mask) >= ((i - hole) & mask)) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole] = EMPTY;
+    count--;
+    return true;
+}
+
+void KeySet::clear() {
+    slots.assign(MIN_KEY_SLOTS, EMPTY);
+    slots.shrink_to_fit();
+    count = 0;
+}
+
+/**
+ * Appends the keys in no particular order
+ */
+void KeySet::appendTo(std::vector<EdgeKey>& keys) const {
+    keys.reserve(keys.size() + count);
+    for(EdgeKey key : slots) {
+        if(key != EMPTY) {
+            keys.push_back(key);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef GCALC_KEYSET_H
+#define GCALC_KEYSET_H
+#include "adjacency.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * Set of edge keys in a single open addressing table with linear probing.
+ * Keys are stored in the slots themselves, so adding an edge doesn't allocate and the whole set is freed at once.
+ * Key 0 marks an empty slot: it is the edge from node 0 to itself, which a graph never holds.
+ * Erased keys don't leave tombstones, the keys after them in the probe sequence are shifted back instead.
+ */
+class KeySet {
+    std::vector<EdgeKey> slots;
+    size_t count;
+
+    static size_t hash(EdgeKey);
+    size_t slotOf(EdgeKey) const;
+    void rehash(size_t);
+
+public:
+    static const EdgeKey EMPTY = 0;
+
+    KeySet();
+
+    bool insert(EdgeKey);
+    bool erase(EdgeKey);
+    bool contains(EdgeKey key) const {return slots[slotOf(key)] == key;}
+    void clear();
+    void appendTo(std::vector<EdgeKey>&) const;
+
+    size_t size() const {return count;}
+    bool empty() const {return count == 0;}
+    size_t bytes() const {return slots.capacity() * sizeof(EdgeKey);}
+};
+
+#endif //GCALC_KEYSET_H
@@ -0,0 +1,282 @@
+#include "packedFile.h"
+#include "graph.h"
+#include "graphFile.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <zlib.h>
+
+#define BLOCK_NODES (1 << 14)
+#define MAX_ZLIB_RATIO 1032 // No zlib stream unpacks to more than this many times its size
+
+struct PackedBlock {
+    std::string bytes; // As stored in the file
+    uint64_t unpacked;
+    NodeId nodes;
+    uint64_t edges;
+};
+
+struct UnpackedBlock {
+    std::vector<char> chars;
+    std::vector<uint64_t> ends; // Where each name ends in chars
+};
+
+/**
+ * Compares names the way SymbolTable::compare() orders them
+ */
+static bool nameBefore(const char* a, size_t lenA, const char* b, size_t lenB) {
+    int result = std::memcmp(a, b, std::min(lenA, lenB));
+    return result < 0 || (result == 0 && lenA < lenB);
+}
+
+static void putVarint(std::string& out, uint64_t value) {
+    while(value >= 0x80) {
+        out += (char) (value | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+/**
+ * Reads varints from a range of bytes, checking every one of them against the end of the range
+ */
+class VarintReader {
+    const unsigned char* next;
+    const unsigned char* end;
+    const std::string& name;
+
+public:
+    VarintReader(const char* first, const char* last, const std::string& fname) :
+            next((const unsigned char*) first), end((const unsigned char*) last), name(fname) {}
+
+    void check(bool condition) const {
+        if(!condition) {
+            throw Graph::GraphException(name, "is not a valid graph file.");
+        }
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for(unsigned shift = 0;; shift += 7) {
+            check(next != end && shift < 64);
+            unsigned char byte = *next++;
+            value |= (uint64_t) (byte & 0x7f) << shift;
+            if((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    const char* bytes(uint64_t count) {
+        check(count <= (uint64_t) (end - next));
+        const char* first = (const char*) next;
+        next += count;
+        return first;
+    }
+
+    bool done() const {return next == end;}
+};
+
+static PackedBlock packBlock(NodeId first, NodeId last, const packedFile::NodeSource& source, bool compress,
+                             const std::string& fname) {
+    PackedBlock block = {std::string(), 0, last - first, 0};
+    std::string rows, name, previous;
+    std::vector<NodeId> targets;
+    for(NodeId i = first; i < last; i++) {
+        source(i, name, targets);
+        size_t shared = 0;
+        while(shared < name.size() && shared < previous.size() && name[shared] == previous[shared]) {
+            shared++;
+        }
+        putVarint(block.bytes, shared);
+        putVarint(block.bytes, name.size() - shared);
+        block.bytes.append(name, shared, std::string::npos);
+        previous.swap(name);
+        putVarint(rows, targets.size());
+        for(size_t k = 0; k < targets.size(); k++) {
+            putVarint(rows, k == 0 ? targets[0] : targets[k] - targets[k - 1] - 1);
+        }
+        block.edges += targets.size();
+    }
+    block.bytes += rows;
+    block.unpacked = block.bytes.size();
+    if(compress) {
+        uLongf size = compressBound(block.unpacked);
+        std::string packed(size, '\0');
+        int result = compress2((Bytef*) &packed[0], &size, (const Bytef*) block.bytes.data(), block.unpacked,
+                               Z_DEFAULT_COMPRESSION);
+        if(result == Z_MEM_ERROR) {
+            throw std::bad_alloc();
+        } else if(result != Z_OK) {
+            throw Graph::GraphException(fname, std::string("could not be compressed: ") + zError(result) + ".");
+        }
+        packed.resize(size);
+        block.bytes.swap(packed);
+    }
+    return block;
+}
+
+bool packedFile::recognizes(const MappedFile& f) {
+    return f.size() >= 8 && std::memcmp(f.data(), PACKED_FILE_MAGIC, 8) == 0;
+}
+
+/**
+ * Packs the nodes in blocks on the shared thread pool, then writes the file next to its destination and renames it
+ * into place, the way graph files are written
+ */
+void packedFile::write(const std::string& fname, NodeId nodes, const NodeSource& source, bool compress) {
+    std::vector<PackedBlock> blocks((nodes + BLOCK_NODES - 1) / BLOCK_NODES);
+    ThreadPool::parallelFor(blocks.size(), [](size_t i){return (uint64_t) i * BLOCK_NODES;},
+                            [&](unsigned, size_t first, size_t last) {
+        for(size_t i = first; i < last; i++) {
+            NodeId begin = (NodeId) (i * BLOCK_NODES);
+            blocks[i] = packBlock(begin, std::min<NodeId>(nodes, begin + BLOCK_NODES), source, compress, fname);
+        }
+    });
+    uint64_t edges = 0;
+    for(const PackedBlock& block : blocks) {
+        edges += block.edges;
+    }
+    std::string head(PACKED_FILE_MAGIC);
+    putVarint(head, compress ? COMPRESSED : 0);
+    putVarint(head, nodes);
+    putVarint(head, edges);
+    putVarint(head, blocks.size());
+    for(const PackedBlock& block : blocks) {
+        putVarint(head, block.bytes.size());
+        putVarint(head, block.unpacked);
+        putVarint(head, block.nodes);
+    }
+
+    std::string temporary = fname + ".tmp";
+    std::ofstream packedFile(temporary, std::ios::binary);
+    if(!packedFile) {
+        throw std::ofstream::failure("Could not open '" + fname + "'.");
+    }
+    packedFile.write(head.data(), head.size());
+    for(const PackedBlock& block : blocks) {
+        packedFile.write(block.bytes.data(), block.bytes.size());
+    }
+    packedFile.close();
+    if(!packedFile || std::rename(temporary.c_str(), fname.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw std::ofstream::failure("Could not write '" + fname + "'.");
+    }
+}
+
+/**
+ * Unpacks the names and edges of a block, checking that the names are valid and in increasing order and that the
+ * targets of every node are other nodes in increasing order
+ */
+static UnpackedBlock unpackBlock(const char* data, uint64_t stored, uint64_t unpacked, bool compressed, NodeId first,
+                                 NodeId count, NodeId nodes, const std::string& fname, std::vector<EdgeKey>& keys) {
+    std::string buffer;
+    if(compressed) {
+        buffer.resize(unpacked);
+        uLongf size = unpacked;
+        VarintReader(nullptr, nullptr, fname).check(
+                uncompress((Bytef*) &buffer[0], &size, (const Bytef*) data, stored) == Z_OK && size == unpacked);
+        data = buffer.data();
+    }
+    VarintReader reader(data, data + unpacked, fname);
+    UnpackedBlock block;
+    size_t previous = 0; // Where the name before the current one starts
+    for(NodeId i = 0; i < count; i++) {
+        uint64_t shared = reader.varint(), rest = reader.varint();
+        size_t start = block.chars.size();
+        reader.check(shared <= start - previous);
+        const char* suffix = reader.bytes(rest);
+        block.chars.resize(start + shared);
+        std::copy_n(block.chars.begin() + previous, shared, block.chars.begin() + start);
+        block.chars.insert(block.chars.end(), suffix, suffix + rest);
+        block.ends.push_back(block.chars.size());
+        const char* name = block.chars.data() + start;
+        size_t length = block.chars.size() - start;
+        reader.check(Graph::validNode(name, length));
+        reader.check(i == 0 || nameBefore(block.chars.data() + previous, start - previous, name, length));
+        previous = start;
+    }
+    for(NodeId i = 0; i < count; i++) {
+        uint64_t degree = reader.varint();
+        reader.check(degree < nodes);
+        uint64_t target = 0;
+        for(uint64_t k = 0; k < degree; k++) {
+            uint64_t gap = reader.varint() + (k == 0 ? 0 : 1);
+            reader.check(gap < nodes - target && (k == 0 || gap > 0));
+            target += gap;
+            reader.check(target != first + i);
+            keys.push_back(edgeKey(first + i, (NodeId) target));
+        }
+    }
+    reader.check(reader.done());
+    return block;
+}
+
+/**
+ * Unpacks a packed file on the shared thread pool, a run of blocks per thread
+ * @param symbols Receives the nodes, numbered in the order of their names
+ * @param runs Receives the edges of each block, sorted
+ */
+void packedFile::read(const MappedFile& file, const std::string& fname, SymbolTable& symbols,
+                      std::vector<std::vector<EdgeKey>>& runs) {
+    VarintReader header(file.data(), file.data() + file.size(), fname);
+    header.check(recognizes(file));
+    header.bytes(8);
+    uint64_t flags = header.varint(), nodes = header.varint(), edges = header.varint(), count = header.varint();
+    header.check((flags & ~(uint64_t) COMPRESSED) == 0 && nodes < SymbolTable::NONE && count <= file.size());
+    struct Entry {
+        uint64_t stored;
+        uint64_t unpacked;
+        NodeId first;
+        NodeId nodes;
+    };
+    std::vector<Entry> table(count);
+    std::vector<uint64_t> costs(count + 1, 0); // The unpacked bytes before each block
+    uint64_t first = 0;
+    for(uint64_t i = 0; i < count; i++) {
+        uint64_t stored = header.varint(), unpacked = header.varint(), blockNodes = header.varint();
+        header.check(blockNodes <= nodes - first && unpacked / MAX_ZLIB_RATIO <= stored &&
+                     ((flags & COMPRESSED) != 0 || unpacked == stored));
+        table[i] = {stored, unpacked, (NodeId) first, (NodeId) blockNodes};
+        first += blockNodes;
+        costs[i + 1] = costs[i] + unpacked;
+    }
+    header.check(first == nodes);
+    std::vector<const char*> data(count);
+    for(uint64_t i = 0; i < count; i++) {
+        data[i] = header.bytes(table[i].stored);
+    }
+    header.check(header.done());
+
+    std::vector<UnpackedBlock> blocks(count);
+    runs.assign(count, std::vector<EdgeKey>());
+    ThreadPool::parallelFor(count, [&costs](size_t i){return costs[i];}, [&](unsigned, size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            blocks[i] = unpackBlock(data[i], table[i].stored, table[i].unpacked, (flags & COMPRESSED) != 0,
+                                    table[i].first, table[i].nodes, (NodeId) nodes, fname, runs[i]);
+        }
+    });
+    std::vector<char> chars;
+    std::vector<uint64_t> starts(1, 0);
+    starts.reserve(nodes + 1);
+    uint64_t found = 0;
+    for(uint64_t i = 0; i < count; i++) {
+        UnpackedBlock& block = blocks[i];
+        if(!block.ends.empty() && starts.size() > 1) {
+            // The names are only compared within blocks so far
+            uint64_t last = starts[starts.size() - 2];
+            header.check(nameBefore(chars.data() + last, chars.size() - last, block.chars.data(), block.ends[0]));
+        }
+        uint64_t base = chars.size();
+        chars.insert(chars.end(), block.chars.begin(), block.chars.end());
+        for(uint64_t end : block.ends) {
+            starts.push_back(base + end);
+        }
+        found += runs[i].size();
+        block = UnpackedBlock();
+    }
+    header.check(found == edges);
+    symbols = SymbolTable(chars, starts);
+}
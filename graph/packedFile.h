@@ -0,0 +1,39 @@
+#ifndef GCALC_PACKEDFILE_H
+#define GCALC_PACKEDFILE_H
+#include "adjacency.h"
+#include "symbolTable.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Packed graph file layout, for archiving graphs. Every number is a base 128 varint, so unlike a graph file it
+ * doesn't depend on the byte order of the machine that wrote it.
+ *     header  magic, flags, node count, edge count, block count
+ *     table   the stored size, unpacked size and node count of every block
+ *     blocks  runs of nodes in the order of their names. A block holds the names of its nodes, each as the length of
+ *             the prefix it shares with the name before it and the rest of the name, then the targets of each node
+ *             as its degree, the index of its first target and the gaps between the next ones.
+ * With the COMPRESSED flag every block is compressed with zlib. Blocks are independent of each other, so they are
+ * packed and unpacked in parallel.
+ */
+#define PACKED_FILE_MAGIC "GCALCPK1"
+
+class MappedFile;
+
+namespace packedFile {
+    enum Flags {COMPRESSED = 1};
+
+    /**
+     * Gives the name and the targets of the node at an index of the name order. The targets are indices too, sorted.
+     */
+    typedef std::function<void(NodeId, std::string& name, std::vector<NodeId>& targets)> NodeSource;
+
+    bool recognizes(const MappedFile&);
+    void write(const std::string& fname, NodeId nodes, const NodeSource& source, bool compress);
+    void read(const MappedFile&, const std::string& fname, SymbolTable& symbols,
+              std::vector<std::vector<EdgeKey>>& runs);
+}
+
+#endif //GCALC_PACKEDFILE_H
@@ -0,0 +1,130 @@
+#include "resultCache.h"
+#include <iterator>
+
+ResultCache::ResultCache(size_t b) : entries(), index(), readers(), holders(), budget(b), used(0), hitCount(0), missCount(0),
+                                     mutex() {}
+
+/**
+ * Drops a result, along with the records of the variables it read
+ */
+void ResultCache::erase(std::list<Entry>::iterator entry) {
+    for(const std::string& variable : entry->variables) {
+        auto range = readers.equal_range(variable);
+        for(auto reader = range.first; reader != range.second; reader++) {
+            if(reader->second == entry->key) {
+                readers.erase(reader);
+                break;
+            }
+        }
+    }
+    auto range = holders.equal_range(entry->value.get());
+    for(auto holder = range.first; holder != range.second; holder++) {
+        if(holder->second == entry->key) {
+            holders.erase(holder);
+            break;
+        }
+    }
+    used -= entry->bytes;
+    index.erase(entry->key);
+    entries.erase(entry);
+}
+
+/**
+ * @return The cached result, or null if there is none
+ */
+SharedGraph ResultCache::find(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = index.find(key);
+    if(iter == index.end()) {
+        missCount++;
+        return nullptr;
+    }
+    hitCount++;
+    entries.splice(entries.begin(), entries, iter->second);
+    return iter->second->value;
+}
+
+/**
+ * Caches a result, unless it alone is larger than the budget
+ * @param variables The variables the result was computed from
+ */
+void ResultCache::insert(const std::string& key, const SharedGraph& value, const std::vector<std::string>& variables) {
+    size_t bytes = value->bytes() + key.size();
+    std::lock_guard<std::mutex> lock(mutex);
+    if(bytes > budget || index.find(key) != index.end()) {
+        return;
+    }
+    entries.push_front({key, value, bytes, variables});
+    index.emplace(key, entries.begin());
+    for(const std::string& variable : variables) {
+        readers.emplace(variable, key);
+    }
+    holders.emplace(value.get(), key);
+    used += bytes;
+    while(used > budget) {
+        erase(std::prev(entries.end()));
+    }
+}
+
+/**
+ * Drops the results that read a variable
+ */
+void ResultCache::invalidate(const std::string& variable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = readers.equal_range(variable);
+    std::vector<std::string> keys;
+    for(auto reader = range.first; reader != range.second; reader++) {
+        keys.push_back(reader->second);
+    }
+    readers.erase(range.first, range.second);
+    for(const std::string& key : keys) {
+        auto iter = index.find(key);
+        if(iter != index.end()) {
+            erase(iter->second);
+        }
+    }
+}
+
+/**
+ * Drops the results that are a graph, so whoever holds the graph alone can change it in place
+ */
+void ResultCache::release(const Graph* value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto range = holders.equal_range(value);
+    std::vector<std::string> keys;
+    for(auto holder = range.first; holder != range.second; holder++) {
+        keys.push_back(holder->second);
+    }
+    for(const std::string& key : keys) {
+        erase(index.at(key));
+    }
+}
+
+void ResultCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    readers.clear();
+    holders.clear();
+    used = 0;
+}
+
+uint64_t ResultCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hitCount;
+}
+
+uint64_t ResultCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return missCount;
+}
+
+size_t ResultCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+size_t ResultCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return used;
+}
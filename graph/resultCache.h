@@ -0,0 +1,54 @@
+#ifndef GCALC_RESULTCACHE_H
+#define GCALC_RESULTCACHE_H
+#include "graph.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define RESULT_CACHE_BYTES ((size_t) 256 << 20) // Memory the cached results may take before the oldest are dropped
+
+/**
+ * Results of subexpressions by a key naming the expression and the versions of the variables it reads.
+ * Once the results take more memory than the budget, the least recently used ones are dropped.
+ * The results that read a variable are dropped as soon as the variable changes, since their keys can't match again.
+ */
+class ResultCache {
+    struct Entry {
+        std::string key;
+        SharedGraph value;
+        size_t bytes;
+        std::vector<std::string> variables;
+    };
+    std::list<Entry> entries; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::unordered_multimap<std::string, std::string> readers; // Keys of the results that read each variable
+    std::unordered_multimap<const Graph*, std::string> holders; // Keys each graph is cached under
+    size_t budget;
+    size_t used;
+    uint64_t hitCount;
+    uint64_t missCount;
+    mutable std::mutex mutex;
+
+    void erase(std::list<Entry>::iterator);
+
+public:
+    explicit ResultCache(size_t budget = RESULT_CACHE_BYTES);
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    SharedGraph find(const std::string& key);
+    void insert(const std::string& key, const SharedGraph&, const std::vector<std::string>& variables);
+    void invalidate(const std::string& variable);
+    void release(const Graph*);
+    void clear();
+
+    uint64_t hits() const;
+    uint64_t misses() const;
+    size_t size() const;
+    size_t bytes() const;
+};
+
+#endif //GCALC_RESULTCACHE_H
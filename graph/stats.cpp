@@ -0,0 +1,186 @@
+#include "stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#define OTHER_STATEMENTS "(other statements)"
+
+Stats::Stats() : statements(), others(), operators(), variables(), allocated(0), copies(0), mutex() {}
+
+/**
+ * @return The text a statement is counted and printed by: the command itself, or its first STATS_PREFIX characters
+ * followed by a hash of the whole command if it is longer
+ */
+static std::string keyOf(const std::string& command) {
+    if(command.size() <= STATS_PREFIX) {
+        return command;
+    }
+    std::ostringstream key;
+    key << command.substr(0, STATS_PREFIX) << "... (" << command.size() << " characters, hash " << std::hex
+        << std::hash<std::string>()(command) << ")";
+    return key.str();
+}
+
+void Stats::statement(const std::string& command, double parse, double evaluate) {
+    std::string key = keyOf(command);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = statements.find(key);
+    if(iter == statements.end() && statements.size() < STATS_STATEMENTS) {
+        iter = statements.emplace(std::move(key), Statement()).first;
+    }
+    Statement& counters = iter == statements.end() ? others : iter->second;
+    counters.runs++;
+    counters.parse += parse;
+    counters.evaluate += evaluate;
+}
+
+void Stats::operation(char op, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Operator& counters = operators[op];
+    counters.runs++;
+    counters.seconds += seconds;
+}
+
+/**
+ * Counts the memory of a graph an evaluation created, or the memory a graph grew by when it was changed in place
+ */
+void Stats::allocation(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    allocated += bytes;
+}
+
+void Stats::copy() {
+    std::lock_guard<std::mutex> lock(mutex);
+    copies++;
+}
+
+/**
+ * Records the memory a variable holds now, 0 once it is deleted or not evaluated yet
+ */
+void Stats::variable(const std::string& name, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Memory& memory = variables[name];
+    memory.current = bytes;
+    memory.peak = std::max(memory.peak, bytes);
+}
+
+/**
+ * Clears every counter. Variables keep the memory they hold now, which becomes their peak.
+ */
+void Stats::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    statements.clear();
+    others = Statement();
+    operators.clear();
+    allocated = 0;
+    copies = 0;
+    for(auto iter = variables.begin(); iter != variables.end();) {
+        iter->second.peak = iter->second.current;
+        iter = iter->second.current == 0 ? variables.erase(iter) : std::next(iter);
+    }
+}
+
+uint64_t Stats::copyCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return copies;
+}
+
+uint64_t Stats::allocatedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return allocated;
+}
+
+/**
+ * Prints the totals, the slowest statements, the operators and the variables, in a form meant to be read
+ */
+void Stats::print(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    typedef std::pair<const std::string, Statement> Entry;
+    const Entry other(OTHER_STATEMENTS, others);
+    std::vector<const Entry*> slowest;
+    double parse = others.parse, evaluate = others.evaluate;
+    for(const Entry& entry : statements) {
+        parse += entry.second.parse;
+        evaluate += entry.second.evaluate;
+        slowest.push_back(&entry);
+    }
+    if(others.runs > 0) {
+        slowest.push_back(&other);
+    }
+    std::sort(slowest.begin(), slowest.end(), [](const Entry* a, const Entry* b) {
+        return a->second.parse + a->second.evaluate > b->second.parse + b->second.evaluate;
+    });
+    slowest.resize(std::min(slowest.size(), (size_t) STATS_SLOWEST));
+
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision(6);
+    os << std::fixed << "statements: " << statements.size() << ", parse: " << parse << "s, evaluate: " << evaluate
+       << "s\n";
+    for(const Entry* entry : slowest) {
+        os << "  " << entry->first << ": " << entry->second.runs << " runs, parse: " << entry->second.parse
+           << "s, evaluate: " << entry->second.evaluate << "s\n";
+    }
+    os << "operators:\n";
+    for(const auto& entry : operators) {
+        os << "  " << entry.first << ": " << entry.second.runs << " runs, " << entry.second.seconds << "s\n";
+    }
+    os << "allocated: " << allocated << " bytes, copies: " << copies << "\n";
+    os << "variables:\n";
+    for(const auto& entry : variables) {
+        os << "  " << entry.first << ": " << entry.second.current << " bytes, peak: " << entry.second.peak
+           << " bytes\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
+
+static std::string jsonString(const std::string& str) {
+    std::string result = "\"";
+    for(char c : str) {
+        if(c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if((unsigned char) c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            result += escaped;
+        } else {
+            result += c;
+        }
+    }
+    return result + '"';
+}
+
+/**
+ * Prints every counter as one JSON object
+ */
+void Stats::printJson(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::streamsize precision = os.precision(9);
+    os << "{\"statements\": [";
+    for(auto iter = statements.begin(); iter != statements.end(); iter++) {
+        os << (iter == statements.begin() ? "" : ", ") << "{\"command\": " << jsonString(iter->first)
+           << ", \"runs\": " << iter->second.runs << ", \"parse_seconds\": " << iter->second.parse
+           << ", \"evaluate_seconds\": " << iter->second.evaluate << "}";
+    }
+    if(others.runs > 0) {
+        os << (statements.empty() ? "" : ", ") << "{\"command\": null, \"runs\": " << others.runs
+           << ", \"parse_seconds\": " << others.parse << ", \"evaluate_seconds\": " << others.evaluate << "}";
+    }
+    os << "], \"operators\": {";
+    for(auto iter = operators.begin(); iter != operators.end(); iter++) {
+        os << (iter == operators.begin() ? "" : ", ") << jsonString(std::string(1, iter->first)) << ": {\"runs\": "
+           << iter->second.runs << ", \"seconds\": " << iter->second.seconds << "}";
+    }
+    os << "}, \"allocated_bytes\": " << allocated << ", \"graph_copies\": " << copies << ", \"variables\": {";
+    for(auto iter = variables.begin(); iter != variables.end(); iter++) {
+        os << (iter == variables.begin() ? "" : ", ") << jsonString(iter->first) << ": {\"bytes\": "
+           << iter->second.current << ", \"peak_bytes\": " << iter->second.peak << "}";
+    }
+    os << "}}" << std::endl;
+    os.precision(precision);
+}
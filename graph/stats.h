@@ -0,0 +1,62 @@
+#ifndef GCALC_STATS_H
+#define GCALC_STATS_H
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#define STATS_SLOWEST 10 // Statements listed when the counters are printed, the JSON dump has all of them
+#define STATS_STATEMENTS 4096 // Statements counted by their text, the ones after them are counted together
+#define STATS_PREFIX 200 // Characters of a statement's text kept, longer statements are told apart by a hash
+
+/**
+ * Counters of where a session's time and memory went: the time each statement spent parsing and evaluating,
+ * the time spent in each operator, the bytes of the graphs evaluations created, how many graphs were copied,
+ * and the memory each variable holds now and held at most.
+ * Statements are counted by their text, so a statement that runs again adds to the same counters. Once there are
+ * STATS_STATEMENTS of them, new statements share one set of counters, so a script that never repeats a statement
+ * doesn't make them grow without end. Long statements are kept as their first STATS_PREFIX characters and a hash of
+ * the rest, so a large literal isn't kept twice.
+ */
+class Stats {
+    struct Statement {
+        uint64_t runs;
+        double parse; // Seconds
+        double evaluate;
+    };
+    struct Operator {
+        uint64_t runs;
+        double seconds;
+    };
+    struct Memory {
+        size_t current; // Bytes
+        size_t peak;
+    };
+    std::map<std::string, Statement> statements;
+    Statement others; // Statements that ran once there were too many to count each
+    std::map<char, Operator> operators;
+    std::map<std::string, Memory> variables;
+    uint64_t allocated;
+    uint64_t copies;
+    mutable std::mutex mutex;
+
+public:
+    Stats();
+    Stats(const Stats&) = delete;
+    Stats& operator=(const Stats&) = delete;
+
+    void statement(const std::string& command, double parse, double evaluate);
+    void operation(char op, double seconds);
+    void allocation(size_t bytes);
+    void copy();
+    void variable(const std::string& name, size_t bytes);
+    void reset();
+
+    uint64_t copyCount() const;
+    uint64_t allocatedBytes() const;
+    void print(std::ostream&) const;
+    void printJson(std::ostream&) const;
+};
+
+#endif //GCALC_STATS_H
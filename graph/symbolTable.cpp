@@ -0,0 +1,397 @@
+#include "symbolTable.h"
+#include "graph.h"
+#include "graphFile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+
+#define MIN_SLOTS 16
+
+const NodeId SymbolTable::NONE;
+
+/**
+ * Names of a product's nodes as pairs of the factors' nodes. Node i * |rightIds| + j stands for the pair of
+ * leftIds[i] and rightIds[j], and its name is "[left;right]". The names are only written out when a caller needs
+ * their characters, and the written table is kept for every copy of the product's table.
+ */
+struct SymbolTable::Pairs {
+    SymbolTable left;
+    SymbolTable right;
+    std::vector<NodeId> leftIds; // The live ids of the factors, in increasing order
+    std::vector<NodeId> rightIds;
+    std::once_flag once;
+    std::atomic<bool> ready;
+    SymbolTable table; // The written names, once ready
+
+    Pairs(const SymbolTable& l, const std::vector<NodeId>& lIds, const SymbolTable& r, const std::vector<NodeId>& rIds)
+        : left(l), right(r), leftIds(lIds), rightIds(rIds), once(), ready(false), table() {}
+
+    /**
+     * Looks a name up by its parts, without writing the names
+     */
+    NodeId find(const char* str, size_t len) const {
+        if(len < 2 || str[0] != '[' || str[len - 1] != ']') {
+            return NONE;
+        }
+        // The left name is a valid name, so its semicolons are all inside brackets
+        int depth = 0;
+        size_t split = 1;
+        while(split < len - 1 && (str[split] != ';' || depth > 0)) {
+            depth += str[split] == '[' ? 1 : (str[split] == ']' ? -1 : 0);
+            split++;
+        }
+        if(split == len - 1) {
+            return NONE;
+        }
+        NodeId l = left.find(str + 1, split - 1), r = right.find(str + split + 1, len - split - 2);
+        auto i = std::lower_bound(leftIds.begin(), leftIds.end(), l);
+        auto j = std::lower_bound(rightIds.begin(), rightIds.end(), r);
+        if(l == NONE || r == NONE || i == leftIds.end() || *i != l || j == rightIds.end() || *j != r) {
+            return NONE;
+        }
+        return (NodeId) ((i - leftIds.begin()) * rightIds.size() + (j - rightIds.begin()));
+    }
+};
+
+// The arrays of an empty table, borrowed until the table changes so empty and moved from tables allocate nothing
+static const uint64_t emptyStarts[1] = {0};
+static const NodeId emptySlots[MIN_SLOTS] = {SymbolTable::NONE, SymbolTable::NONE, SymbolTable::NONE,
+                                             SymbolTable::NONE, SymbolTable::NONE, SymbolTable::NONE,
+                                             SymbolTable::NONE, SymbolTable::NONE, SymbolTable::NONE,
+                                             SymbolTable::NONE, SymbolTable::NONE, SymbolTable::NONE,
+                                             SymbolTable::NONE, SymbolTable::NONE, SymbolTable::NONE,
+                                             SymbolTable::NONE};
+
+SymbolTable::SymbolTable() : chars(), starts(Buffer<uint64_t>::unowned(emptyStarts, 1)), live(),
+                             slots(Buffer<NodeId>::unowned(emptySlots, MIN_SLOTS)), liveCount(0), pairs() {}
+
+/**
+ * Reads the table in place from a graph file. Only the sizes of the arrays are checked, so loading stays O(1);
+ * check() walks the names themselves.
+ */
+SymbolTable::SymbolTable(GraphReader& reader) : chars(reader.read<char>()), starts(reader.read<uint64_t>()),
+                                                live(reader.read<uint8_t>()), slots(reader.read<NodeId>()),
+                                                liveCount(reader.value<NodeId>()), pairs() {
+    reader.check(starts.size() == live.size() + 1 && live.size() < NONE && starts[0] == 0 &&
+                 starts.back() == chars.size() && liveCount <= live.size());
+    // The probes rely on a power of two table with room to spare
+    reader.check(slots.size() >= MIN_SLOTS && (slots.size() & (slots.size() - 1)) == 0 && slots.size() > live.size());
+}
+
+/**
+ * Checks a table read from a graph file in one linear pass: every name lies within the characters and the hash table
+ * holds every live id once and finds its name
+ */
+void SymbolTable::check(const GraphReader& reader) const {
+    NodeId count = 0;
+    for(NodeId id = 0; id < bound(); id++) {
+        reader.check(starts[id] <= starts[id + 1] && live[id] <= 1);
+        count += live[id];
+    }
+    reader.check(count == liveCount);
+    NodeId filled = 0;
+    for(size_t i = 0; i < slots.size(); i++) {
+        reader.check(slots[i] == NONE || alive(slots[i]));
+        filled += slots[i] != NONE;
+    }
+    reader.check(filled == liveCount);
+    for(NodeId id = 0; id < bound(); id++) {
+        reader.check(!live[id] || slots[slotOf(data(id), length(id), hash(data(id), length(id)))] == id);
+    }
+}
+
+/**
+ * Builds a table from distinct names laid out back to back, taking their arrays
+ * @param starts Name i is names[starts[i], starts[i + 1])
+ */
+SymbolTable::SymbolTable(std::vector<char>& names, std::vector<uint64_t>& s) : SymbolTable() {
+    chars.swap(names);
+    starts.swap(s);
+    live.assign(starts.size() - 1, 1);
+    liveCount = bound();
+    size_t slotCount = MIN_SLOTS;
+    while(slotCount <= 2 * (size_t) liveCount) {
+        slotCount *= 2;
+    }
+    rehash(slotCount);
+}
+
+uint64_t SymbolTable::hash(const char* str, size_t len) {
+    // 64 bit FNV-1a, stable between runs so it can be written to disk
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) str[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Probes for a name
+ * @return The slot holding the name's id, or the empty slot where it would be inserted
+ */
+size_t SymbolTable::slotOf(const char* str, size_t len, uint64_t h) const {
+    size_t mask = slots.size() - 1;
+    for(size_t i = h & mask;; i = (i + 1) & mask) {
+        NodeId id = slots[i];
+        if(id == NONE || (length(id) == len && (len == 0 || std::memcmp(data(id), str, len) == 0))) {
+            return i;
+        }
+    }
+}
+
+void SymbolTable::rehash(size_t slotCount) {
+    slots.assign(slotCount, NONE);
+    size_t mask = slotCount - 1;
+    for(NodeId id = 0; id < bound(); id++) {
+        if(!live[id]) {
+            continue;
+        }
+        size_t i = hash(data(id), length(id)) & mask;
+        while(slots[i] != NONE) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = id;
+    }
+}
+
+/**
+ * Names the nodes of a product by pairs of the factors' nodes, without writing the names
+ * @param leftIds The live ids of the left factor in increasing order, and the same for rightIds
+ * @throws Graph::GraphException If the product has more nodes than ids can number
+ */
+SymbolTable SymbolTable::product(const SymbolTable& left, const std::vector<NodeId>& leftIds,
+                                 const SymbolTable& right, const std::vector<NodeId>& rightIds) {
+    if((uint64_t) leftIds.size() * rightIds.size() >= NONE) {
+        throw Graph::GraphException(std::to_string(leftIds.size()) + "*" + std::to_string(rightIds.size()),
+                                    "nodes are more than a graph can hold.");
+    }
+    SymbolTable result;
+    NodeId count = (NodeId) (leftIds.size() * rightIds.size());
+    if(count > 0) {
+        result.pairs = std::make_shared<Pairs>(left, leftIds, right, rightIds);
+        result.live.assign(count, 1);
+        result.liveCount = count;
+    }
+    return result;
+}
+
+/**
+ * @return The table with the names written out, written on first use
+ */
+const SymbolTable& SymbolTable::built() const {
+    Pairs& p = *pairs;
+    std::call_once(p.once, [this, &p]() {
+        std::string name;
+        for(NodeId id = 0; id < bound(); id++) {
+            name.clear();
+            appendName(id, name);
+            if(id == 0) {
+                p.table.reserve(bound(), (size_t) bound() * name.size());
+            }
+            p.table.intern(name);
+        }
+        p.ready = true;
+    });
+    return p.table;
+}
+
+/**
+ * Writes the names out into the table itself, before it is modified
+ */
+void SymbolTable::own() {
+    if(pairs) {
+        SymbolTable table = built();
+        *this = std::move(table);
+    }
+}
+
+void SymbolTable::appendName(NodeId id, std::string& out) const {
+    if(!pairs || pairs->ready) {
+        out.append(data(id), length(id));
+        return;
+    }
+    size_t width = pairs->rightIds.size();
+    out += '[';
+    pairs->left.appendName(pairs->leftIds[id / width], out);
+    out += ';';
+    pairs->right.appendName(pairs->rightIds[id % width], out);
+    out += ']';
+}
+
+std::string SymbolTable::name(NodeId id) const {
+    std::string out;
+    appendName(id, out);
+    return out;
+}
+
+size_t SymbolTable::bytes() const {
+    size_t total = chars.bytes() + starts.bytes() + live.bytes() + slots.bytes();
+    if(pairs) {
+        total += pairs->left.bytes() + pairs->right.bytes() +
+                 (pairs->leftIds.capacity() + pairs->rightIds.capacity()) * sizeof(NodeId);
+        total += pairs->ready ? pairs->table.bytes() : 0;
+    }
+    return total;
+}
+
+NodeId SymbolTable::find(const char* str, size_t len) const {
+    if(pairs) {
+        return pairs->ready ? pairs->table.find(str, len) : pairs->find(str, len);
+    }
+    return slots[slotOf(str, len, hash(str, len))];
+}
+
+NodeId SymbolTable::find(const std::string& name) const {
+    return find(name.data(), name.size());
+}
+
+NodeId SymbolTable::intern(const char* str, size_t len) {
+    own();
+    uint64_t h = hash(str, len);
+    size_t slot = slotOf(str, len, h);
+    if(slots[slot] != NONE) {
+        return slots[slot];
+    }
+    NodeId id = bound();
+    chars.append(str, str + len);
+    starts.push_back(chars.size());
+    live.push_back(1);
+    liveCount++;
+    if(2 * (size_t) bound() > slots.size()) {
+        rehash(2 * slots.size()); // Keep the load factor under a half
+    } else {
+        slots[slot] = id;
+    }
+    return id;
+}
+
+NodeId SymbolTable::intern(const std::string& name) {
+    return intern(name.data(), name.size());
+}
+
+void SymbolTable::erase(NodeId id) {
+    if(!alive(id)) {
+        return;
+    }
+    own();
+    size_t mask = slots.size() - 1, hole = slotOf(data(id), length(id), hash(data(id), length(id)));
+    // Backward shift deletion keeps every probe sequence intact without tombstones
+    for(size_t i = (hole + 1) & mask; slots[i] != NONE; i = (i + 1) & mask) {
+        size_t home = hash(data(slots[i]), length(slots[i])) & mask;
+        bool movable = (hole <= i) ? (home <= hole || home > i) : (home <= hole && home > i);
+        if(movable) {
+            slots[hole] = slots[i];
+            hole = i;
+        }
+    }
+    slots[hole] = NONE;
+    live[id] = 0;
+    liveCount--;
+}
+
+void SymbolTable::reserve(NodeId count, size_t bytes) {
+    own();
+    chars.reserve(bytes);
+    starts.reserve(count + 1);
+    live.reserve(count);
+    size_t slotCount = slots.size();
+    while(slotCount < 2 * (size_t) count) {
+        slotCount *= 2;
+    }
+    if(slotCount != slots.size()) {
+        rehash(slotCount);
+    }
+}
+
+/**
+ * Empties the table without allocating
+ */
+void SymbolTable::clear() {
+    chars.clear();
+    starts = Buffer<uint64_t>::unowned(emptyStarts, 1);
+    live.clear();
+    slots = Buffer<NodeId>::unowned(emptySlots, MIN_SLOTS);
+    liveCount = 0;
+    pairs.reset();
+}
+
+/**
+ * Gives the live names consecutive ids in the order of their old ids, drops the erased ones and frees the room the
+ * arrays grew into but don't use
+ * @return The new id of every old id, NONE for erased ids
+ */
+std::vector<NodeId> SymbolTable::compact() {
+    std::vector<NodeId> map(bound());
+    if(pairs || erased() == 0) {
+        for(NodeId id = 0; id < bound(); id++) {
+            map[id] = id;
+        }
+        if(!pairs) {
+            chars.compact();
+            starts.compact();
+            live.compact();
+        }
+        return map;
+    }
+    size_t bytes = 0;
+    for(NodeId id = 0; id < bound(); id++) {
+        bytes += live[id] ? length(id) : 0;
+    }
+    SymbolTable table;
+    table.reserve(liveCount, bytes);
+    for(NodeId id = 0; id < bound(); id++) {
+        map[id] = live[id] ? table.intern(data(id), length(id)) : NONE;
+    }
+    *this = std::move(table);
+    return map;
+}
+
+void SymbolTable::save(GraphWriter& writer) const {
+    if(pairs) {
+        built().save(writer);
+        return;
+    }
+    writer.add(chars);
+    writer.add(starts);
+    writer.add(live);
+    writer.add(slots);
+    writer.add(&liveCount, 1);
+}
+
+int SymbolTable::compare(NodeId a, NodeId b) const {
+    size_t lenA = length(a), lenB = length(b);
+    int result = std::memcmp(data(a), data(b), std::min(lenA, lenB));
+    return result != 0 ? result : (lenA < lenB ? -1 : (lenA > lenB ? 1 : 0));
+}
+
+/**
+ * @return The live ids, ordered by their names
+ */
+std::vector<NodeId> SymbolTable::sorted() const {
+    if(pairs) {
+        return built().sorted();
+    }
+    std::vector<NodeId> out;
+    out.reserve(liveCount);
+    for(NodeId id = 0; id < bound(); id++) {
+        if(live[id]) {
+            out.push_back(id);
+        }
+    }
+    std::sort(out.begin(), out.end(), [this](NodeId a, NodeId b){return compare(a, b) < 0;});
+    return out;
+}
+
+/**
+ * @param order The live ids as returned by sorted()
+ * @return For every id, the position of its name in sorted order (NONE for erased ids)
+ */
+std::vector<NodeId> SymbolTable::ranks(const std::vector<NodeId>& order) const {
+    std::vector<NodeId> out(bound(), NONE);
+    for(NodeId i = 0; i < (NodeId) order.size(); i++) {
+        out[order[i]] = i;
+    }
+    return out;
+}
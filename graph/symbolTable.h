@@ -0,0 +1,72 @@
+#ifndef GCALC_SYMBOLTABLE_H
+#define GCALC_SYMBOLTABLE_H
+#include "buffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+typedef uint32_t NodeId;
+
+class GraphWriter;
+class GraphReader;
+
+/**
+ * Interns node names to dense integer ids.
+ * Names are stored back to back in a single character buffer and looked up through an open addressing hash table
+ * that only holds ids, so every name is stored exactly once.
+ * Erased ids are never reused, they stay as tombstones until compact() gives the live names consecutive ids.
+ * The arrays are written to graph files as they are, and a loaded table reads them from the mapped file.
+ * The table of a product can instead keep its names as pairs of the factors' nodes, see product().
+ */
+class SymbolTable {
+    struct Pairs;
+    Buffer<char> chars;
+    Buffer<uint64_t> starts; // Name i is chars[starts[i], starts[i + 1])
+    Buffer<uint8_t> live;
+    Buffer<NodeId> slots;
+    NodeId liveCount;
+    std::shared_ptr<Pairs> pairs; // Set while the names are kept as pairs, shared by the copies of the table
+
+    static uint64_t hash(const char*, size_t);
+    size_t slotOf(const char*, size_t, uint64_t) const;
+    void rehash(size_t);
+    const SymbolTable& names() const {return pairs ? built() : *this;}
+    const SymbolTable& built() const;
+    void own();
+    void appendName(NodeId, std::string&) const;
+
+public:
+    static const NodeId NONE = UINT32_MAX;
+
+    SymbolTable();
+    explicit SymbolTable(GraphReader&);
+    SymbolTable(std::vector<char>& names, std::vector<uint64_t>& starts);
+    static SymbolTable product(const SymbolTable&, const std::vector<NodeId>&, const SymbolTable&,
+                               const std::vector<NodeId>&);
+
+    NodeId find(const char*, size_t) const;
+    NodeId find(const std::string&) const;
+    NodeId intern(const char*, size_t);
+    NodeId intern(const std::string&);
+    void erase(NodeId);
+    void reserve(NodeId, size_t);
+    void clear();
+    std::vector<NodeId> compact();
+    void save(GraphWriter&) const;
+    void check(const GraphReader&) const;
+
+    bool alive(NodeId id) const {return id < live.size() && live[id];}
+    NodeId size() const {return liveCount;}
+    NodeId erased() const {return bound() - liveCount;}
+    NodeId bound() const {return (NodeId) live.size();}
+    size_t bytes() const;
+    const char* data(NodeId id) const {const SymbolTable& t = names(); return t.chars.data() + t.starts[id];}
+    size_t length(NodeId id) const {const SymbolTable& t = names(); return t.starts[id + 1] - t.starts[id];}
+    std::string name(NodeId) const;
+    int compare(NodeId, NodeId) const;
+    std::vector<NodeId> sorted() const;
+    std::vector<NodeId> ranks(const std::vector<NodeId>&) const;
+};
+
+#endif //GCALC_SYMBOLTABLE_H
@@ -0,0 +1,104 @@
+#include "threadPool.h"
+#include <atomic>
+#include <cstdlib>
+
+#define THREADS_VARIABLE "GCALC_THREADS"
+
+ThreadPool::ThreadPool(unsigned threads) : workers(), tasks(), mutex(), ready(), stopping(false) {
+    grow(threads);
+}
+
+/**
+ * Adds workers until there are at least the given number, and at least one
+ */
+void ThreadPool::grow(unsigned threads) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while(workers.size() < std::max(threads, 1u)) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+/**
+ * Runs the tasks that are still queued, then stops the workers
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for(std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::work() {
+    while(true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [this](){return stopping || !tasks.empty();});
+            if(tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+/**
+ * Runs the task at the front of the queue on the calling thread
+ * @return Whether there was a task to run
+ */
+bool ThreadPool::runQueued() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(tasks.empty()) {
+            return false;
+        }
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+/**
+ * @return The thread count set in the environment, or the number of hardware threads
+ */
+static unsigned defaultThreads() {
+    const char* value = std::getenv(THREADS_VARIABLE);
+    long threads = value == nullptr ? 0 : std::strtol(value, nullptr, 10);
+    return threads > 0 ? (unsigned) threads : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+static std::atomic<unsigned>& configuredThreads() {
+    static std::atomic<unsigned> threads(defaultThreads());
+    return threads;
+}
+
+/**
+ * @return The pool shared by the whole program, with a worker per configured thread
+ */
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(threads());
+    return pool;
+}
+
+/**
+ * @return How many threads parallel work is split between
+ */
+unsigned ThreadPool::threads() {
+    return configuredThreads();
+}
+
+/**
+ * Changes how many threads parallel work is split between. The shared pool grows to match but never shrinks.
+ */
+void ThreadPool::setThreads(unsigned threads) {
+    configuredThreads() = std::max(threads, 1u);
+    shared().grow(threads);
+}
@@ -0,0 +1,130 @@
+#ifndef GCALC_THREADPOOL_H
+#define GCALC_THREADPOOL_H
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#define PARALLEL_CUTOFF (1 << 16) // Work below this many elements per thread is done on the calling thread
+
+/**
+ * Set of worker threads that run tasks in the order they were submitted.
+ * Threads waiting for a task through await() run queued tasks meanwhile, so tasks can wait for tasks of their own.
+ */
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping;
+
+    void work();
+    bool runQueued();
+
+public:
+    explicit ThreadPool(unsigned threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    void grow(unsigned threads);
+
+    /**
+     * Queues a task
+     * @return The task's result, or the exception it threw
+     */
+    template<class F>
+    std::future<typename std::result_of<F()>::type> submit(F f) {
+        typedef typename std::result_of<F()>::type Result;
+        std::shared_ptr<std::packaged_task<Result()>> task = std::make_shared<std::packaged_task<Result()>>(std::move(f));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back([task](){(*task)();});
+        }
+        ready.notify_one();
+        return result;
+    }
+
+    /**
+     * Waits for a task's result, running queued tasks until it is ready. A thread only blocks once the queue is
+     * empty, when the task it waits for is already running, so waiting tasks can't hold up the tasks they wait for.
+     */
+    template<class T>
+    T await(std::future<T>& result) {
+        while(result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if(!runQueued()) {
+                result.wait();
+            }
+        }
+        return result.get();
+    }
+
+    static ThreadPool& shared();
+    static unsigned threads();
+    static void setThreads(unsigned);
+
+    /**
+     * Splits the items [0, n) into ranges of about the same cost and calls f(part, begin, end) for each range,
+     * on the shared pool and the calling thread. Small inputs are done in a single call on the calling thread.
+     * @param cost cost(i) is the total cost of the items before i, so it never decreases
+     * @param f Called with part numbers below threads(), the ranges are in the same order as the parts
+     * @return The number of parts
+     */
+    template<class Cost, class F>
+    static unsigned parallelFor(size_t n, Cost cost, F f) {
+        uint64_t total = cost(n);
+        unsigned parts = (unsigned) std::min<uint64_t>(threads(), total / PARALLEL_CUTOFF);
+        if(parts <= 1) {
+            f(0u, (size_t) 0, n);
+            return 1;
+        }
+        // Each split is the first item whose cost reaches its share, found by binary search
+        std::vector<size_t> bounds(parts + 1, n);
+        bounds[0] = 0;
+        for(unsigned k = 1; k < parts; k++) {
+            size_t low = bounds[k - 1], high = n;
+            while(low < high) {
+                size_t middle = low + (high - low) / 2;
+                if(cost(middle) < total / parts * k) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            bounds[k] = low;
+        }
+        std::vector<std::future<void>> done;
+        for(unsigned k = 1; k < parts; k++) {
+            done.push_back(shared().submit([&f, &bounds, k](){f(k, bounds[k], bounds[k + 1]);}));
+        }
+        std::exception_ptr error;
+        try {
+            f(0u, bounds[0], bounds[1]);
+        } catch(...) {
+            error = std::current_exception();
+        }
+        // Every part has to finish before the ranges and f go out of scope
+        for(std::future<void>& part : done) {
+            try {
+                shared().await(part);
+            } catch(...) {
+                error = error ? error : std::current_exception();
+            }
+        }
+        if(error) {
+            std::rethrow_exception(error);
+        }
+        return parts;
+    }
+};
+
+#endif //GCALC_THREADPOOL_H
@@ -0,0 +1,86 @@
+#include "versionedGraph.h"
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+VersionedGraph::Snapshot::Snapshot(const Graph* g, Slot* s) : graph(g), slot(s) {}
+
+VersionedGraph::Snapshot::Snapshot(Snapshot&& other) noexcept : graph(other.graph), slot(other.slot) {
+    other.slot = nullptr;
+}
+
+VersionedGraph::Snapshot::~Snapshot() {
+    if(slot != nullptr) {
+        slot->epoch.store(IDLE);
+    }
+}
+
+VersionedGraph::VersionedGraph(Graph initial) : current(nullptr), epoch(0), slots(), retired(), writer() {
+    for(Slot& slot : slots) {
+        slot.epoch.store(IDLE);
+    }
+    initial.freeze();
+    current.store(new Graph(std::move(initial)));
+}
+
+VersionedGraph::~VersionedGraph() {
+    delete current.load();
+}
+
+/**
+ * Pins the current version. The reader announces the epoch before it reads the version, so a writer that doesn't
+ * see the announcement replaced the version before the read, and the reader gets the new one.
+ * Every operation here is sequentially consistent, which is what the argument relies on.
+ */
+VersionedGraph::Snapshot VersionedGraph::pin() const {
+    static thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for(size_t i = hint;; i++) {
+        Slot& slot = slots[i % SNAPSHOT_SLOTS];
+        uint64_t idle = IDLE;
+        if(slot.epoch.load() == IDLE && slot.epoch.compare_exchange_strong(idle, epoch.load())) {
+            hint = i;
+            return Snapshot(current.load(), &slot);
+        }
+        if((i + 1 - hint) % SNAPSHOT_SLOTS == 0) {
+            std::this_thread::yield(); // Every slot is taken
+        }
+    }
+}
+
+/**
+ * Replaces the current version. Readers that pinned the old version keep it until they are done with it.
+ */
+void VersionedGraph::publish(Graph&& next) {
+    std::lock_guard<std::mutex> lock(writer);
+    publishLocked(std::move(next));
+}
+
+void VersionedGraph::publishLocked(Graph&& next) {
+    next.freeze();
+    const Graph* old = current.exchange(new Graph(std::move(next)));
+    retired.emplace_back(epoch.fetch_add(1), std::unique_ptr<const Graph>(old));
+    reclaim();
+}
+
+/**
+ * Deletes the versions no reader holds: a reader that announced a later epoch than the one a version was
+ * replaced in read the pointer after it was replaced
+ */
+void VersionedGraph::reclaim() {
+    uint64_t oldest = IDLE;
+    for(const Slot& slot : slots) {
+        oldest = std::min(oldest, slot.epoch.load());
+    }
+    retired.erase(std::remove_if(retired.begin(), retired.end(), [oldest](const Retired& version) {
+        return version.first < oldest;
+    }), retired.end());
+}
+
+/**
+ * @return How many replaced versions are still held for readers
+ */
+size_t VersionedGraph::retiredCount() {
+    std::lock_guard<std::mutex> lock(writer);
+    reclaim();
+    return retired.size();
+}
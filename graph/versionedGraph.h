@@ -0,0 +1,78 @@
+#ifndef GCALC_VERSIONEDGRAPH_H
+#define GCALC_VERSIONEDGRAPH_H
+#include "graph.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#define SNAPSHOT_SLOTS 256 // Snapshots that can be pinned at once, pin() waits for a free slot beyond that
+#define CACHE_LINE 64
+
+/**
+ * Graph that is read by many threads while a writer replaces it from time to time.
+ * Readers pin the current version and query it without locks. Writers build a new version and publish it
+ * atomically, and a version is deleted once no reader can still hold it.
+ * Versions are reclaimed by epochs: every publish starts a new epoch, a reader announces the epoch it pinned in,
+ * and a replaced version is deleted once every pinned reader announced a later epoch than the one it was replaced in.
+ */
+class VersionedGraph {
+    struct Slot {
+        std::atomic<uint64_t> epoch; // Epoch of the reader holding the slot, or IDLE
+        char padding[CACHE_LINE - sizeof(std::atomic<uint64_t>)]; // Readers on different slots don't share a line
+    };
+    static const uint64_t IDLE = UINT64_MAX;
+
+    std::atomic<const Graph*> current;
+    std::atomic<uint64_t> epoch;
+    mutable Slot slots[SNAPSHOT_SLOTS];
+    typedef std::pair<uint64_t, std::unique_ptr<const Graph>> Retired; // A replaced version and the epoch it left in
+    std::vector<Retired> retired;
+    std::mutex writer;
+
+    void publishLocked(Graph&&);
+    void reclaim();
+
+public:
+    /**
+     * Immutable version of the graph, valid until the snapshot is destroyed
+     */
+    class Snapshot {
+        const Graph* graph;
+        Slot* slot;
+    public:
+        Snapshot(const Graph*, Slot*);
+        Snapshot(const Snapshot&) = delete;
+        Snapshot(Snapshot&&) noexcept;
+        Snapshot& operator=(const Snapshot&) = delete;
+        ~Snapshot();
+        const Graph& operator*() const {return *graph;}
+        const Graph* operator->() const {return graph;}
+    };
+
+    explicit VersionedGraph(Graph initial = Graph());
+    VersionedGraph(const VersionedGraph&) = delete;
+    VersionedGraph& operator=(const VersionedGraph&) = delete;
+    ~VersionedGraph();
+
+    Snapshot pin() const;
+    void publish(Graph&&);
+
+    /**
+     * Publishes a copy of the current version changed by f. Writers wait for each other, readers don't wait.
+     * @param f Called with the copy
+     */
+    template<class F>
+    void update(F f) {
+        std::lock_guard<std::mutex> lock(writer);
+        Graph next(*current.load());
+        f(next);
+        publishLocked(std::move(next));
+    }
+
+    size_t retiredCount();
+};
+
+#endif //GCALC_VERSIONEDGRAPH_H
@@ -1,15 +1,14 @@
 #include "stringUtils.h"
 #include <algorithm>
 #include <cctype>
-#include <regex>
 
-std::vector<string> stringUtils::split(string str, const string& delim) {
+std::vector<string> stringUtils::split(const string& str, const string& delim) {
     std::vector<string> out;
-    size_t pos;
+    size_t start = 0, pos;
     do {
-        pos = str.find(delim);
-        out.push_back(str.substr(0, pos));
-        str.erase(0, pos + delim.length());
+        pos = str.find(delim, start);
+        out.push_back(str.substr(start, pos == string::npos ? pos : pos - start));
+        start = pos + delim.length();
     } while (pos != string::npos);
     return out;
 }
@@ -40,14 +39,41 @@ string stringUtils::rstrip(string str) {
     return str;
 }
 
+static bool isWord(char c) {
+    return isalnum((unsigned char) c) || c == '_';
+}
+
+static bool isSpace(char c) {
+    return isspace((unsigned char) c);
+}
+
 /**
- * Matches all whitespace and groups the whitespace that is between alphanumeric characters
+ * Removes all whitespace, except for whitespace that is between a pair of word characters that it separates.
+ * A word character that ends one such pair doesn't start another, so in "a b c" only the first space stays.
  * @param str The input string
  * @return  A string with the matched, non-grouped whitespace removed
  */
 string stringUtils::removeWhitespace(const string& str) {
-    std::regex re(R"((\w\s+\w)|\s+)");
-    return std::regex_replace(str, re, "$1");
+    string result;
+    result.reserve(str.size());
+    size_t i = 0;
+    while(i < str.size()) {
+        if(isSpace(str[i])) {
+            i++;
+            continue;
+        }
+        size_t next = i + 1;
+        while(isWord(str[i]) && next < str.size() && isSpace(str[next])) {
+            next++;
+        }
+        if(next > i + 1 && next < str.size() && isWord(str[next])) {
+            result.append(str, i, next + 1 - i); // Kept along with the word characters around it
+            i = next + 1;
+        } else {
+            result += str[i++];
+        }
+    }
+    return result;
 }
 
 bool stringUtils::startsWith(const string& str, const string& prefix) {
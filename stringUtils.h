@@ -7,7 +7,7 @@
 using std::string;
 
 namespace stringUtils {
-    std::vector<string> split(string str, const string& delim);
+    std::vector<string> split(const string& str, const string& delim);
     std::vector<std::string>  partition(const string& str, const std::string& delim);
     string strip(string);
     string lstrip(string);
@@ -1,9 +1,61 @@
 #include "wrappers.h"
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+// Every graph has its own lock, which the calls that use it hold. Python threads run while a call has released the
+// GIL, and even reads of a graph merge its pending edges and index it, so no two calls use the same graph at once.
+// Calls on different graphs run side by side, and each still splits its work between threads.
+static std::mutex registry;
+static std::unordered_map<const Graph*, std::unique_ptr<std::mutex>> locks;
+
+static std::mutex& lockOf(const Graph* graph) {
+    std::lock_guard<std::mutex> lock(registry);
+    std::unique_ptr<std::mutex>& mutex = locks[graph];
+    if(!mutex) {
+        mutex.reset(new std::mutex());
+    }
+    return *mutex;
+}
+
+/**
+ * Holds the locks of the graphs a call uses, taken in address order so calls that share graphs can't deadlock.
+ * A graph passed twice is locked once.
+ */
+class GraphLocks {
+    std::vector<std::unique_lock<std::mutex>> held;
+
+public:
+    GraphLocks(std::initializer_list<const Graph*> graphs) {
+        std::vector<std::mutex*> mutexes;
+        for(const Graph* graph : graphs) {
+            mutexes.push_back(&lockOf(graph));
+        }
+        std::sort(mutexes.begin(), mutexes.end());
+        mutexes.erase(std::unique(mutexes.begin(), mutexes.end()), mutexes.end());
+        for(std::mutex* mutex : mutexes) {
+            held.emplace_back(*mutex);
+        }
+    }
+};
 
 Graph* create() {return new Graph();}
-void destroy(Graph* graph) {delete graph;}
+void destroy(Graph* graph) {
+    std::unique_ptr<std::mutex> mutex; // Outlives the lock below
+    std::unique_lock<std::mutex> lock(lockOf(graph)); // Waits for the calls still using it
+    {
+        std::lock_guard<std::mutex> hold(registry);
+        mutex = std::move(locks[graph]);
+        locks.erase(graph); // Before the address can be reused by a new graph
+    }
+    delete graph;
+}
 Graph* addVertex(Graph* graph, const std::string& n) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
     try {
         graph->addNode(n);
     } catch(const Graph::GraphException& e) {
@@ -13,6 +65,7 @@ Graph* addVertex(Graph* graph, const std::string& n) {
 }
 
 Graph* addEdge(Graph* graph, const std::string& n1, const std::string& n2) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
     try {
         graph->addEdge(n1, n2);
     } catch(const Graph::GraphException& e) {
@@ -21,29 +74,119 @@ Graph* addEdge(Graph* graph, const std::string& n1, const std::string& n2) {
     return graph;
 }
 
-void disp(Graph* graph) {std::cout << *graph << std::endl;}
+/**
+ * Adds every name in one call. Nothing is added if one of them is invalid.
+ */
+Graph* addVertices(Graph* graph, const std::vector<std::string>& nodes) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    try {
+        graph->addNodes(nodes);
+    } catch(const Graph::GraphException& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+    return graph;
+}
+
+/**
+ * Adds every (source, target) pair in one call. Nothing is added if one of them is invalid.
+ */
+Graph* addEdges(Graph* graph, const std::vector<std::pair<std::string, std::string>>& edges) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    try {
+        graph->addEdges(edges);
+    } catch(const std::invalid_argument& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+    return graph;
+}
+
+/**
+ * Adds the nodes and edges of a text edge list, read in place from a bytes-like object
+ */
+Graph* addEdgeList(Graph* graph, const char* text, size_t length) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    try {
+        graph->addEdgeList(text, length);
+    } catch(const std::invalid_argument& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
+    return graph;
+}
+
+std::vector<std::string> vertices(Graph* graph) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    std::vector<std::string> result;
+    Graph::NodeView nodes = graph->getNodes();
+    result.reserve(nodes.size());
+    for(const std::string& n : nodes) {
+        result.push_back(n);
+    }
+    return result;
+}
+
+std::vector<std::pair<std::string, std::string>> edges(Graph* graph) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    return graph->edges();
+}
+
+/**
+ * The names in one newline separated string, which Python gets as a single bytes object instead of a list
+ */
+std::string vertexBytes(Graph* graph) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    std::string result;
+    for(const std::string& n : graph->getNodes()) {
+        result += n;
+        result += '\n';
+    }
+    return result;
+}
+
+/**
+ * The graph as one text edge list, the format addEdgeList() reads, which Python gets as a single bytes object
+ */
+std::string edgeBytes(Graph* graph) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    std::ostringstream text;
+    graph->write(text, Graph::EDGE_LIST);
+    return text.str();
+}
+
+void disp(Graph* graph) {
+    std::lock_guard<std::mutex> lock(lockOf(graph));
+    std::cout << *graph << std::endl;
+}
 
 Graph* graphUnion(Graph* g1, Graph* g2, Graph* out) {
+    GraphLocks lock({g1, g2, out});
     *out = Graph::unite(*g1, *g2);
     return out;
 }
 
 Graph* graphIntersection(Graph* g1, Graph* g2, Graph* out) {
+    GraphLocks lock({g1, g2, out});
     *out = Graph::intersection(*g1, *g2);
     return out;
 }
 
 Graph* graphDifference(Graph* g1, Graph* g2, Graph* out) {
+    GraphLocks lock({g1, g2, out});
     *out = Graph::difference(*g1, *g2);
     return out;
 }
 
 Graph* graphProduct(Graph* g1, Graph* g2, Graph* out) {
-    *out = Graph::product(*g1, *g2);
+    GraphLocks lock({g1, g2, out});
+    try {
+        *out = Graph::product(*g1, *g2);
+    } catch(const Graph::GraphException& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+    }
     return out;
 }
 
 Graph* graphComplement(Graph* g, Graph* out) {
+    GraphLocks lock({g, out});
     *out = g->complement();
     return out;
 }
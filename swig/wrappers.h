@@ -1,11 +1,21 @@
 #ifndef GCALC_WRAPPERS_H
 #define GCALC_WRAPPERS_H
 #include "../graph/graph.h"
+#include <string>
+#include <utility>
+#include <vector>
 
 Graph* create();
 void destroy(Graph*);
 Graph* addVertex(Graph*, const std::string&);
 Graph* addEdge(Graph*, const std::string&, const std::string&);
+Graph* addVertices(Graph*, const std::vector<std::string>&);
+Graph* addEdges(Graph*, const std::vector<std::pair<std::string, std::string>>&);
+Graph* addEdgeList(Graph*, const char* text, size_t length);
+std::vector<std::string> vertices(Graph*);
+std::vector<std::pair<std::string, std::string>> edges(Graph*);
+std::string vertexBytes(Graph*);
+std::string edgeBytes(Graph*);
 void disp(Graph*);
 Graph* graphUnion(Graph*, Graph*, Graph*);
 Graph* graphIntersection(Graph*, Graph*, Graph*);
@@ -1,6 +1,19 @@
+#include "graph/fileCache.h"
+#include "graph/gcalc.h"
 #include "graph/graph.h"
+#include "graph/keySet.h"
+#include "graph/resultCache.h"
+#include "graph/stats.h"
+#include "graph/threadPool.h"
+#include "graph/versionedGraph.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <sstream>
+#include <thread>
 
 #define ASSERT_TEST(b) do { \
         if (!(b)) { \
@@ -54,6 +67,27 @@ bool testCtorAssignment() {
     ASSERT_TEST(g2.getNodes().empty());
     Graph g3 = g1;
     ASSERT_TEST(g3.getNodes().empty());
+    g1.addNode(nodes[0]);
+    g1.addNode(nodes[1]);
+    g1.addEdge(nodes[0], nodes[1]);
+    Graph g4(std::move(g1));
+    ASSERT_TEST(g4.getNodes().size() == 2 && g4.adjacent(nodes[0], nodes[1]));
+    ASSERT_TEST(g1.getNodes().empty() && g1.edgeCount() == 0);
+    g3 = std::move(g4);
+    ASSERT_TEST(g3.adjacent(nodes[0], nodes[1]));
+    ASSERT_TEST(g4.getNodes().empty());
+    g4.addNode(nodes[2]);
+    ASSERT_TEST(g4.containsNode(nodes[2]));
+    // Moved from graphs are empty graphs that allocate once they are changed
+    ASSERT_TEST(g1.bytes() == Graph().bytes());
+    g1.addNode(nodes[3]);
+    g1.addNode(nodes[4]);
+    g1.addEdge(nodes[4], nodes[3]);
+    g1.save("moved_graph.gc");
+    ASSERT_TEST(Graph::load("moved_graph.gc").adjacent(nodes[4], nodes[3]));
+    Graph().save("moved_graph.gc");
+    ASSERT_TEST(Graph::load("moved_graph.gc").getNodes().empty());
+    std::remove("moved_graph.gc");
     return true;
 }
 
@@ -144,10 +178,1023 @@ bool testAddRemoveEdge() {
     return true;
 }
 
+bool testPredecessors() {
+    Graph g1;
+    for(const Node& n : nodes) {
+        g1.addNode(n);
+    }
+    for(int i = 1; i < SIZE; i++) {
+        g1.addEdge(nodes[0], nodes[i]);
+        g1.addEdge(nodes[i], nodes[0]);
+    }
+    ASSERT_TEST(g1.predecessors(nodes[0]).size() == SIZE - 1);
+    ASSERT_TEST(g1.predecessors(nodes[1]).size() == 1);
+    ASSERT_TEST(g1.predecessors(nodes[1]).count(nodes[0]) == 1);
+    g1.removeEdge(nodes[1], nodes[0]);
+    ASSERT_TEST(g1.predecessors(nodes[0]).count(nodes[1]) == 0);
+    g1.removeNode(nodes[0]);
+    for(int i = 1; i < SIZE; i++) {
+        ASSERT_TEST(g1.neighbours(nodes[i]).empty());
+        ASSERT_TEST(g1.predecessors(nodes[i]).empty());
+    }
+    g1.addNode(nodes[0]);
+    ASSERT_TEST(g1.neighbours(nodes[0]).empty());
+    ASSERT_TEST(g1.predecessors(nodes[0]).empty());
+    return true;
+}
+
+bool testRenumber() {
+    Graph g1, removed;
+    for(int i = 0; i < 100; i++) {
+        g1.addNode("n" + std::to_string(i));
+    }
+    for(int i = 0; i < 100; i++) {
+        for(int j = 0; j < 100; j++) {
+            if(i != j) {
+                g1.addEdge("n" + std::to_string(i), "n" + std::to_string(j));
+            }
+        }
+    }
+    for(int i = 50; i < 100; i++) {
+        removed.addNode("n" + std::to_string(i));
+    }
+    size_t bytes = g1.bytes();
+    for(int round = 0; round < 20; round++) {
+        // Removed ids are renumbered away instead of growing the bit matrix every round
+        g1.subtract(removed);
+        g1.uniteWith(removed);
+        for(int i = 50; i < 100; i++) {
+            g1.removeNode("n" + std::to_string(i));
+            g1.addNode("n" + std::to_string(i));
+        }
+    }
+    ASSERT_TEST(g1.getNodes().size() == 100 && g1.edgeCount() == 50 * 49);
+    ASSERT_TEST(g1.adjacent("n0", "n49") && !g1.adjacent("n0", "n50") && g1.neighbours("n99").empty());
+    ASSERT_TEST(g1.bytes() <= 2 * bytes);
+    g1.removeNode("n1");
+    g1.compact();
+    ASSERT_TEST(g1.getNodes().size() == 99 && g1.edgeCount() == 49 * 48 && g1.adjacent("n49", "n2"));
+    ASSERT_TEST(!g1.containsNode("n1") && g1.predecessors("n0").size() == 48);
+    return true;
+}
+
+bool testOperators() {
+    Graph g1, g2;
+    for(int i = 0; i < 3; i++) {
+        g1.addNode(nodes[i]);
+        g2.addNode(nodes[i + 2]);
+    }
+    g1.addEdge(nodes[0], nodes[1]);
+    g1.addEdge(nodes[1], nodes[2]);
+    g2.addEdge(nodes[2], nodes[3]);
+    Graph united = Graph::unite(g1, g2);
+    ASSERT_TEST(united.getNodes().size() == 5);
+    ASSERT_TEST(united.adjacent(nodes[0], nodes[1]) && united.adjacent(nodes[2], nodes[3]));
+    Graph intersected = Graph::intersection(g1, g2);
+    ASSERT_TEST(intersected.getNodes().size() == 1);
+    ASSERT_TEST(intersected.neighbours(nodes[2]).empty());
+    Graph difference = Graph::difference(g1, g2);
+    ASSERT_TEST(difference.getNodes().size() == 2);
+    ASSERT_TEST(difference.getNodes().find(nodes[2]) == difference.getNodes().end());
+    ASSERT_TEST(difference.adjacent(nodes[0], nodes[1]));
+    Graph product = Graph::product(g1, g2);
+    ASSERT_TEST(product.getNodes().size() == 9);
+    ASSERT_TEST(product.adjacent("[a;c23]", "[B;d10]"));
+    ASSERT_TEST(product.neighbours("[B;c23]").size() == 1);
+    Graph complement = g1.complement();
+    ASSERT_TEST(complement.getNodes().size() == 3);
+    ASSERT_TEST(!complement.adjacent(nodes[0], nodes[1]));
+    ASSERT_TEST(complement.adjacent(nodes[1], nodes[0]));
+    ASSERT_TEST(complement.neighbours(nodes[0]).size() == 1);
+    return true;
+}
+
+bool testInPlaceOperators() {
+    Graph g1, g2;
+    for(int i = 0; i < 3; i++) {
+        g1.addNode(nodes[i]);
+        g2.addNode(nodes[i + 2]);
+    }
+    g1.addEdge(nodes[0], nodes[1]);
+    g1.addEdge(nodes[1], nodes[2]);
+    g2.addEdge(nodes[2], nodes[3]);
+    Graph united(g1);
+    united.uniteWith(g2);
+    ASSERT_TEST(united.getNodes().size() == 5 && united.edgeCount() == 3);
+    ASSERT_TEST(united.adjacent(nodes[2], nodes[3]));
+    united.intersectWith(g1);
+    ASSERT_TEST(united.getNodes().size() == 3 && united.edgeCount() == 2);
+    ASSERT_TEST(!united.containsNode(nodes[3]));
+    united.subtract(g2);
+    ASSERT_TEST(united.getNodes().size() == 2 && united.edgeCount() == 1);
+    ASSERT_TEST(united.adjacent(nodes[0], nodes[1]));
+    ASSERT_TEST(united.predecessors(nodes[1]).size() == 1);
+    united.uniteWith(united);
+    ASSERT_TEST(united.edgeCount() == 1);
+    united.subtract(united);
+    ASSERT_TEST(united.getNodes().empty());
+    return true;
+}
+
+bool testSaveLoad() {
+    const char* fname = "test_graph.gc";
+    Graph g1;
+    for(const Node& n : nodes) {
+        g1.addNode(n);
+    }
+    for(int i = 1; i < SIZE; i++) {
+        g1.addEdge(nodes[i - 1], nodes[i]);
+    }
+    g1.removeNode(nodes[SIZE - 1]);
+    g1.save(fname);
+    ASSERT_TEST(Graph::verify(fname));
+    Graph loaded = Graph::load(fname);
+    ASSERT_TEST(loaded.getNodes().size() == SIZE - 1 && loaded.edgeCount() == SIZE - 2);
+    ASSERT_TEST(loaded.adjacent(nodes[0], nodes[1]) && !loaded.containsNode(nodes[SIZE - 1]));
+    ASSERT_TEST(loaded.predecessors(nodes[1]).count(nodes[0]) == 1);
+    Graph copy(loaded);
+    loaded.addNode(nodes[SIZE - 1]);
+    loaded.addEdge(nodes[SIZE - 1], nodes[0]);
+    ASSERT_TEST(loaded.adjacent(nodes[SIZE - 1], nodes[0]));
+    ASSERT_TEST(!copy.containsNode(nodes[SIZE - 1]) && copy.edgeCount() == SIZE - 2);
+    loaded.save(fname); // Replaces the file copy is still mapped from
+    ASSERT_TEST(copy.neighbours(nodes[0]).size() == 1);
+    ASSERT_TEST(Graph::load(fname).edgeCount() == SIZE - 1);
+    {
+        std::fstream file(fname, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-1, std::ios::end);
+        file.put('\xff');
+    }
+    ASSERT_TEST(!Graph::verify(fname));
+    std::remove(fname);
+    return true;
+}
+
+bool testCorruptFile() {
+    const char* fname = "test_graph.gc";
+    Graph g1;
+    for(const Node& n : nodes) {
+        g1.addNode(n);
+    }
+    for(int i = 1; i < SIZE; i++) {
+        g1.addEdge(nodes[0], nodes[i]);
+    }
+    g1.save(fname);
+    std::stringstream contents;
+    contents << std::ifstream(fname, std::ios::binary).rdbuf();
+    const std::string saved = contents.str();
+    // The sections are the names, their starts, the live marks, the slots and the live count, then the offsets,
+    // degrees and targets of the rows and the edge count. Each case overwrites one element of one of them. Loading
+    // only checks the sizes of the arrays, so only the first cases fail to load; verify() rejects all of them.
+    const struct {
+        unsigned section;
+        unsigned index;
+        unsigned width;
+        uint64_t value;
+        bool load;
+    } damages[] = {{1, 0, 8, 1, true}, {5, 0, 8, 1, true}, {4, 0, 4, SIZE + 1, true}, {1, 1, 8, 1 << 20, false},
+                   {2, 1, 1, 7, false}, {3, 1, 4, 1000, false}, {5, 1, 8, 1 << 20, false}, {6, 1, 4, 1000, false},
+                   {7, 1, 4, 1000, false}, {7, 1, 4, 0, false}};
+    for(const auto& damage : damages) {
+        std::string bytes = saved;
+        uint64_t offset; // Of the section, the first field of its entry in the table after the 24 byte header
+        std::memcpy(&offset, bytes.data() + 24 + 32 * damage.section, sizeof(offset));
+        std::memcpy(&bytes[offset + damage.index * damage.width], &damage.value, damage.width);
+        std::ofstream(fname, std::ios::binary) << bytes;
+        ASSERT_TEST(!Graph::verify(fname));
+        if(!damage.load) {
+            continue;
+        }
+        try {
+            Graph::load(fname);
+        } catch(const Graph::GraphException& e) {
+            ASSERT_TEST(std::string(e.what()) == "'test_graph.gc' is not a valid graph file.");
+            continue;
+        }
+        ASSERT_TEST(false);
+    }
+    std::ofstream(fname, std::ios::binary) << saved.substr(0, saved.size() - 8);
+    try {
+        Graph::load(fname);
+        ASSERT_TEST(false);
+    } catch(const Graph::GraphException&) {}
+    std::ofstream(fname, std::ios::binary) << saved;
+    ASSERT_TEST(Graph::load(fname).edgeCount() == SIZE - 1);
+    std::remove(fname);
+    return true;
+}
+
+bool testArchive() {
+    const char* fname = "test_graph.pk";
+    Graph g1;
+    for(int i = 0; i < 40000; i++) { // More nodes than a block holds
+        g1.addNode("node" + std::to_string(i));
+    }
+    for(int i = 1; i < 40000; i += 3) {
+        g1.addEdge("node" + std::to_string(i), "node" + std::to_string(i - 1));
+        g1.addEdge("node" + std::to_string(i), "node" + std::to_string((i * 7919) % 40000));
+    }
+    g1.removeNode("node0");
+    for(bool compress : {false, true}) {
+        g1.archive(fname, compress);
+        Graph loaded = Graph::load(fname);
+        ASSERT_TEST(loaded.getNodes().size() == g1.getNodes().size() && loaded.edgeCount() == g1.edgeCount());
+        ASSERT_TEST(loaded.adjacent("node4", "node3") && !loaded.containsNode("node0"));
+        ASSERT_TEST(Graph::difference(g1, loaded).getNodes().empty() && Graph::difference(loaded, g1).getNodes().empty());
+    }
+    Graph small;
+    small.addNodes({"b", "a", "[a;b]"});
+    small.addEdges({{"a", "b"}, {"[a;b]", "a"}});
+    Graph product = Graph::product(small, small);
+    product.archive(fname, true);
+    Graph loaded = Graph::load(fname);
+    ASSERT_TEST(loaded.edgeCount() == product.edgeCount() && loaded.adjacent("[[a;b];a]", "[a;b]"));
+    {
+        std::fstream file(fname, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-2, std::ios::end);
+        file.put('\x55');
+    }
+    bool rejected = false;
+    try {
+        Graph::load(fname);
+    } catch(const Graph::GraphException&) {
+        rejected = true;
+    }
+    ASSERT_TEST(rejected);
+    std::remove(fname);
+    return true;
+}
+
+bool testSaveLoadAll() {
+    const char* fname = "test_workspace.ws";
+    Graph sparse, dense, empty;
+    sparse.addNodes({"a", "b", "c"});
+    sparse.addEdges({{"a", "b"}, {"b", "c"}});
+    for(int i = 0; i < 20; i++) {
+        dense.addNode("n" + std::to_string(i));
+    }
+    dense = dense.complement();
+    Graph product = Graph::product(sparse, sparse);
+    Graph::saveAll(fname, {{"S", &sparse}, {"D", &dense}, {"E", &empty}, {"P", &product}});
+    std::vector<std::pair<std::string, Graph>> loaded = Graph::loadAll(fname);
+    ASSERT_TEST(loaded.size() == 4 && loaded[0].first == "S" && loaded[3].first == "P");
+    ASSERT_TEST(loaded[0].second.edgeCount() == 2 && loaded[0].second.adjacent("a", "b"));
+    ASSERT_TEST(loaded[1].second.edgeCount() == 20 * 19 && loaded[1].second.adjacent("n19", "n0"));
+    ASSERT_TEST(loaded[2].second.getNodes().empty());
+    ASSERT_TEST(loaded[3].second.getNodes().size() == 9 && loaded[3].second.adjacent("[a;a]", "[b;b]"));
+    bool rejected = false;
+    try {
+        Graph::load(fname);
+    } catch(const Graph::GraphException&) {
+        rejected = true;
+    }
+    ASSERT_TEST(rejected);
+    std::remove(fname);
+    return true;
+}
+
+bool testImport() {
+    const char* fname = "test_edges.txt";
+    {
+        std::ofstream file(fname);
+        file << "# source target\na B\nB\tc23\n\n  d10  \nB c23\nc23 a";
+    }
+    ImportStats stats;
+    Graph g1 = Graph::import(fname, stats);
+    ASSERT_TEST(stats.lines == 7);
+    ASSERT_TEST(g1.getNodes().size() == 4 && g1.edgeCount() == 3);
+    ASSERT_TEST(g1.adjacent(nodes[0], nodes[1]) && g1.adjacent(nodes[2], nodes[0]));
+    ASSERT_TEST(g1.neighbours(nodes[3]).empty());
+    {
+        std::ofstream file(fname);
+        file << "a B\nB B\n";
+    }
+    bool threw = false;
+    try {
+        Graph::import(fname, stats);
+    } catch(const Graph::Edge::EdgeError&) {
+        threw = true;
+    }
+    ASSERT_TEST(threw);
+    std::remove(fname);
+    return true;
+}
+
+bool testProductNames() {
+    Graph g1;
+    g1.addNodes({"a", "b", "gone", "[x;y]"});
+    g1.addEdges({{"a", "b"}, {"b", "[x;y]"}});
+    g1.removeNode("gone");
+    Graph square = Graph::product(g1, g1), cube = Graph::product(square, g1);
+    // Looked up by their parts, before any name is written
+    ASSERT_TEST(cube.getNodes().size() == 27 && cube.edgeCount() == 8);
+    ASSERT_TEST(cube.adjacent("[[a;b];a]", "[[b;[x;y]];b]") && !cube.adjacent("[[a;b];a]", "[[b;b];b]"));
+    ASSERT_TEST(cube.containsNode("[[[x;y];a];b]") && !cube.containsNode("[[gone;a];b]"));
+    ASSERT_TEST(!cube.containsNode("[a;[b;a]]") && !cube.containsNode("[[a;b];b;a]") && !cube.containsNode("[]"));
+    ASSERT_TEST(cube.predecessors("[[b;[x;y]];b]") == std::set<Node>({"[[a;b];a]"}));
+    std::ostringstream text;
+    text << cube;
+    ASSERT_TEST(text.str().find("[[[x;y];[x;y]];[x;y]]\n[[[x;y];[x;y]];a]\n") == 0);
+    const char* fname = "test_product.gc";
+    cube.save(fname);
+    Graph copy(cube);
+    cube.addNode("c"); // Writes the names into the graph's own table
+    cube.removeNode("[[a;a];a]");
+    ASSERT_TEST(cube.getNodes().size() == 27 && cube.containsNode("c") && copy.containsNode("[[a;a];a]"));
+    Graph loaded = Graph::load(fname);
+    ASSERT_TEST(loaded.getNodes().size() == 27 && loaded.adjacent("[[a;b];a]", "[[b;[x;y]];b]"));
+    std::remove(fname);
+    // 2^16 * 2^16 nodes are more than ids can number, which fails before any id wraps around
+    std::vector<Node> names;
+    for(int i = 0; i < (1 << 16); i++) {
+        names.push_back("n" + std::to_string(i));
+    }
+    Graph wide;
+    wide.addNodes(names);
+    try {
+        Graph::product(wide, wide);
+        ASSERT_TEST(false);
+    } catch(const Graph::GraphException& e) {
+        ASSERT_TEST(std::string(e.what()) == "'65536*65536' nodes are more than a graph can hold.");
+    }
+    return true;
+}
+
+bool testKeySet() {
+    KeySet keys;
+    for(NodeId u = 1; u <= 1000; u++) {
+        ASSERT_TEST(keys.insert(edgeKey(u, u % 7)) && !keys.insert(edgeKey(u, u % 7)));
+    }
+    for(NodeId u = 1; u <= 1000; u += 2) {
+        ASSERT_TEST(keys.erase(edgeKey(u, u % 7)) && !keys.erase(edgeKey(u, u % 7)));
+    }
+    bool found = true;
+    for(NodeId u = 1; u <= 1000; u++) {
+        found = found && keys.contains(edgeKey(u, u % 7)) == (u % 2 == 0); // Erasing kept the probes intact
+    }
+    std::vector<EdgeKey> all;
+    keys.appendTo(all);
+    ASSERT_TEST(found && keys.size() == 500 && all.size() == 500);
+    keys.clear();
+    ASSERT_TEST(keys.empty() && !keys.contains(edgeKey(2, 2)));
+    return true;
+}
+
+bool testBuild() {
+    SymbolTable symbols;
+    NodeId a = symbols.intern("a"), b = symbols.intern("b"), c = symbols.intern("c");
+    std::vector<EdgeKey> keys {edgeKey(c, a), edgeKey(a, b), edgeKey(c, a)};
+    Graph g1 = Graph::build(std::move(symbols), keys);
+    ASSERT_TEST(keys.size() == 2 && g1.getNodes().size() == 3 && g1.edgeCount() == 2);
+    ASSERT_TEST(g1.adjacent("c", "a") && g1.adjacent("a", "b") && !g1.adjacent("b", "a"));
+    return true;
+}
+
+bool testBulk() {
+    Graph g1;
+    g1.addNodes({"c", "a", "b"});
+    g1.addEdges({{"c", "a"}, {"a", "b"}, {"c", "a"}});
+    ASSERT_TEST(g1.getNodes().size() == 3 && g1.edgeCount() == 2);
+    bool threw = false;
+    try {
+        g1.addNodes({"d", "e;"});
+    } catch(const Graph::InvalidName&) {
+        threw = true;
+    }
+    ASSERT_TEST(threw && !g1.containsNode("d"));
+    std::string text = "# comment\nb d\ne\na c\n";
+    g1.addEdgeList(text.data(), text.size());
+    ASSERT_TEST(g1.getNodes().size() == 5 && g1.edgeCount() == 4);
+    std::vector<std::pair<Node, Node>> edges {{"a", "b"}, {"a", "c"}, {"b", "d"}, {"c", "a"}};
+    ASSERT_TEST(g1.edges() == edges);
+    return true;
+}
+
+bool testWriteFormats() {
+    Graph g1;
+    for(const char* n : {"c", "a", "b"}) {
+        g1.addNode(n);
+    }
+    g1.addEdge("b", "a");
+    std::ostringstream text, edges, dot, binary;
+    g1.write(text, Graph::TEXT);
+    g1.write(edges, Graph::EDGE_LIST);
+    g1.write(dot, Graph::DOT);
+    g1.write(binary, Graph::BINARY);
+    ASSERT_TEST(text.str() == "a\nb\nc\n$\nb a");
+    ASSERT_TEST(edges.str() == "c\nb a\n");
+    ASSERT_TEST(dot.str() == "digraph G {\n    \"a\";\n    \"b\";\n    \"c\";\n    \"b\" -> \"a\";\n}\n");
+    ASSERT_TEST(binary.str().size() == 8 + 4 + 8 + 3 * 5 + 8 && binary.str().compare(0, 8, "GCALCEL1") == 0);
+    return true;
+}
+
+bool testOperatorRuns() {
+    Graph g1, g2, g3;
+    g1.addNodes({"a", "b", "c"});
+    g2.addNodes({"a", "b", "c", "x", "y"});
+    g3.addNodes({"a", "b", "c", "y"});
+    g1.addEdges({{"a", "b"}, {"b", "c"}, {"c", "a"}});
+    g2.addEdges({{"a", "b"}, {"c", "a"}, {"x", "y"}});
+    g3.addEdges({{"c", "a"}, {"b", "c"}, {"a", "y"}});
+    Graph all(g1), common(g1), rest(g1);
+    all.uniteWith({&g2, &g3});
+    ASSERT_TEST(all.getNodes().size() == 5 && all.edgeCount() == 5 && all.adjacent("a", "y"));
+    common.intersectWith({&g2, &g3});
+    ASSERT_TEST(common.getNodes().size() == 3 && common.edgeCount() == 1 && common.adjacent("c", "a"));
+    Graph pairwise(g1);
+    pairwise.intersectWith(g2);
+    pairwise.intersectWith(g3);
+    ASSERT_TEST(pairwise.getNodes().size() == 3 && pairwise.edgeCount() == 1 && pairwise.adjacent("c", "a"));
+    g2.removeNode("a");
+    rest.subtract({&g2, &g3});
+    ASSERT_TEST(rest.getNodes().empty());
+    Graph kept(all);
+    kept.subtract({&g2});
+    ASSERT_TEST(kept.getNodes().size() == 1 && kept.containsNode("a") && kept.edgeCount() == 0);
+    return true;
+}
+
+bool testDenseOperators() {
+    const int count = 100;
+    Graph g1;
+    for(int i = 0; i < count; i++) {
+        g1.addNode("n" + std::to_string(i));
+    }
+    for(int i = 1; i < count; i++) {
+        g1.addEdge("n" + std::to_string(i - 1), "n" + std::to_string(i));
+    }
+    Graph complement = g1.complement();
+    ASSERT_TEST(complement.edgeCount() == count * (count - 1) - (count - 1));
+    ASSERT_TEST(!complement.adjacent("n0", "n1"));
+    ASSERT_TEST(complement.adjacent("n1", "n0"));
+    ASSERT_TEST(complement.neighbours("n0").size() == count - 2);
+    ASSERT_TEST(complement.predecessors("n1").size() == count - 2);
+    Graph twice = complement.complement();
+    ASSERT_TEST(twice.edgeCount() == count - 1);
+    ASSERT_TEST(twice.adjacent("n0", "n1"));
+    Graph complete = Graph::unite(g1, complement);
+    ASSERT_TEST(complete.edgeCount() == count * (count - 1));
+    ASSERT_TEST(Graph::intersection(g1, complement).edgeCount() == 0);
+    Graph half = Graph::intersection(complete, twice);
+    ASSERT_TEST(half.edgeCount() == count - 1);
+    Graph rest = Graph::difference(complete, g1);
+    ASSERT_TEST(rest.getNodes().empty());
+    Graph accumulated(g1);
+    accumulated.uniteWith(complement);
+    ASSERT_TEST(accumulated.edgeCount() == complete.edgeCount());
+    accumulated.intersectWith(twice);
+    ASSERT_TEST(accumulated.edgeCount() == count - 1 && accumulated.adjacent("n0", "n1"));
+    complete.removeNode("n0");
+    ASSERT_TEST(complete.edgeCount() == (count - 1) * (count - 2));
+    complete.addNode("n0");
+    complete.addEdge("n0", "n1");
+    ASSERT_TEST(complete.neighbours("n0").size() == 1);
+    ASSERT_TEST(complete.predecessors("n0").empty());
+    return true;
+}
+
+bool testParallelOperators() {
+    const char* fnames[] = {"test_edges1.txt", "test_edges2.txt"};
+    uint32_t state = 1;
+    for(const char* fname : fnames) {
+        std::ofstream file(fname);
+        for(int i = 0; i < 150000; i++) {
+            state = state * 1103515245 + 12345;
+            int u = (state >> 8) % 5000, v = ((state >> 8) / 5000) % 5000;
+            if(u != v) {
+                file << "n" << u << " n" << v << "\n";
+            }
+        }
+    }
+    ImportStats stats;
+    Graph g1 = Graph::import(fnames[0], stats), g2 = Graph::import(fnames[1], stats);
+    std::vector<Graph> results[2];
+    for(int run = 0; run < 2; run++) {
+        ThreadPool::setThreads(run == 0 ? 1 : 4);
+        results[run].push_back(Graph::unite(g1, g2));
+        results[run].push_back(Graph::intersection(g1, g2));
+        results[run].push_back(Graph::difference(g1, g2));
+        Graph accumulated(g1);
+        accumulated.uniteWith(g2);
+        results[run].push_back(accumulated);
+        accumulated.intersectWith(g1);
+        results[run].push_back(accumulated);
+    }
+    ThreadPool::setThreads(1);
+    for(unsigned i = 0; i < results[0].size(); i++) {
+        ASSERT_TEST(results[0][i].edgeCount() == results[1][i].edgeCount());
+        for(int u = 0; u < 5000; u += 97) {
+            std::string name = "n" + std::to_string(u);
+            ASSERT_TEST(results[0][i].containsNode(name) == results[1][i].containsNode(name));
+            if(results[0][i].containsNode(name)) {
+                ASSERT_TEST(results[0][i].neighbours(name) == results[1][i].neighbours(name));
+                ASSERT_TEST(results[0][i].predecessors(name) == results[1][i].predecessors(name));
+            }
+        }
+    }
+    ASSERT_TEST(results[1][3].edgeCount() == results[1][0].edgeCount());
+    ASSERT_TEST(results[1][4].edgeCount() == g1.edgeCount());
+    for(const char* fname : fnames) {
+        std::remove(fname);
+    }
+    return true;
+}
+
+bool testResultCache() {
+    SharedGraph g1 = std::make_shared<Graph>(), g2 = std::make_shared<Graph>();
+    const_cast<Graph&>(*g1).addNode("a");
+    ResultCache cache(g1->bytes() + g2->bytes() + 16);
+    cache.insert("(A#1+B#2)", g1, {"A", "B"});
+    cache.insert("!B#2", g2, {"B"});
+    ASSERT_TEST(cache.find("(A#1+B#2)") == g1 && cache.find("!A#1") == nullptr);
+    ASSERT_TEST(cache.hits() == 1 && cache.misses() == 1 && cache.size() == 2);
+    cache.insert("!A#1", g1, {"A"}); // Over the budget, so the least recently used result goes
+    ASSERT_TEST(cache.find("!B#2") == nullptr && cache.find("!A#1") == g1);
+    cache.invalidate("A");
+    ASSERT_TEST(cache.size() == 0 && cache.bytes() == 0);
+    cache.insert("(A#2+B#2)", g2, {"A", "B"});
+    cache.insert("!B#2", g1, {"B"});
+    cache.release(g2.get()); // Before g2 is changed in place
+    ASSERT_TEST(cache.size() == 1 && g2.use_count() == 1 && cache.find("!B#2") == g1);
+    cache.invalidate("B");
+    ASSERT_TEST(cache.size() == 0 && g1.use_count() == 1);
+    return true;
+}
+
+bool testStats() {
+    Stats stats;
+    stats.statement("A=B+C", 0.5, 1);
+    stats.operation('+', 1);
+    stats.copy();
+    stats.allocation(100);
+    stats.variable("A", 100);
+    stats.variable("A", 40);
+    std::ostringstream json;
+    stats.printJson(json);
+    ASSERT_TEST(json.str() == "{\"statements\": [{\"command\": \"A=B+C\", \"runs\": 1, \"parse_seconds\": 0.5, "
+                              "\"evaluate_seconds\": 1}], \"operators\": {\"+\": {\"runs\": 1, \"seconds\": 1}}, "
+                              "\"allocated_bytes\": 100, \"graph_copies\": 1, \"variables\": {\"A\": {\"bytes\": 40, "
+                              "\"peak_bytes\": 100}}}\n");
+    stats.reset(); // Variables keep what they hold now
+    json.str("");
+    stats.printJson(json);
+    ASSERT_TEST(stats.copyCount() == 0 && stats.allocatedBytes() == 0);
+    ASSERT_TEST(json.str().find("\"A\": {\"bytes\": 40, \"peak_bytes\": 40}") != std::string::npos);
+    // Past STATS_STATEMENTS different statements, new ones are counted together
+    for(int i = 0; i < STATS_STATEMENTS + 10; i++) {
+        stats.statement("A={a" + std::to_string(i) + "}", 0, 1);
+    }
+    stats.statement("A={a0}", 0, 1);
+    json.str("");
+    stats.printJson(json);
+    ASSERT_TEST(json.str().find("{\"command\": \"A={a0}\", \"runs\": 2, ") != std::string::npos);
+    ASSERT_TEST(json.str().find("{\"command\": null, \"runs\": 10, ") != std::string::npos);
+    std::ostringstream printed;
+    stats.print(printed);
+    ASSERT_TEST(printed.str().find("statements: 4096, parse: 0.000000s, evaluate: 4107.000000s\n"
+                                   "  (other statements): 10 runs, ") == 0);
+    // Long statements are kept as their start and a hash, and told apart by it
+    stats.reset();
+    std::string literal = "A={" + std::string(1 << 20, 'a') + "}";
+    stats.statement(literal, 0, 1);
+    stats.statement(literal, 0, 1);
+    literal[literal.size() - 2] = 'b';
+    stats.statement(literal, 0, 1);
+    json.str("");
+    stats.printJson(json);
+    ASSERT_TEST(json.str().size() < 2000);
+    std::string prefix = "{\"command\": \"A={" + std::string(STATS_PREFIX - 3, 'a') + "... (1048580 characters, hash ";
+    size_t first = json.str().find(prefix);
+    ASSERT_TEST(first != std::string::npos && json.str().find(prefix, first + 1) != std::string::npos);
+    ASSERT_TEST(json.str().find("\"runs\": 2, ") != std::string::npos);
+    return true;
+}
+
+bool testVersionedGraph() {
+    VersionedGraph versions;
+    {
+        VersionedGraph::Snapshot first = versions.pin();
+        versions.update([](Graph& g){g.addNode("n0");});
+        ASSERT_TEST(first->getNodes().empty() && versions.pin()->containsNode("n0"));
+        ASSERT_TEST(versions.retiredCount() == 1); // Still pinned
+    }
+    ASSERT_TEST(versions.retiredCount() == 0);
+
+    // Version k is the path n0 -> ... -> nk, readers must never see one half written
+    std::atomic<bool> done(false), consistent(true);
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 4; i++) {
+        readers.emplace_back([&]() {
+            while(!done) {
+                VersionedGraph::Snapshot g = versions.pin();
+                size_t last = g->getNodes().size() - 1;
+                std::string tail = "n" + std::to_string(last);
+                if(g->edgeCount() != last || (last > 0 && g->predecessors(tail).size() != 1)) {
+                    consistent = false;
+                }
+            }
+        });
+    }
+    for(int k = 1; k <= 200; k++) {
+        versions.update([k](Graph& g) {
+            g.addNode("n" + std::to_string(k));
+            g.addEdge("n" + std::to_string(k - 1), "n" + std::to_string(k));
+        });
+    }
+    done = true;
+    for(std::thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_TEST(consistent && versions.pin()->edgeCount() == 200 && versions.retiredCount() == 0);
+    return true;
+}
+
+/**
+ * Runs a script the way gcalc runs a file, with statements in parallel when there is more than one thread
+ * @return What the script printed
+ */
+static std::string runScript(const std::string& script, unsigned threads = 1) {
+    const char* inName = "script_in.txt";
+    const char* outName = "script_out.txt";
+    std::ofstream(inName) << script;
+    unsigned before = ThreadPool::threads();
+    ThreadPool::setThreads(threads);
+    std::streambuf* input = std::cin.rdbuf();
+    std::streambuf* output = std::cout.rdbuf();
+    GCalc(new std::ifstream(inName), new std::ofstream(outName)).run();
+    std::cin.rdbuf(input);
+    std::cout.rdbuf(output);
+    std::cin.clear();
+    std::cout.clear();
+    ThreadPool::setThreads(before);
+    std::stringstream printed;
+    printed << std::ifstream(outName).rdbuf();
+    std::remove(inName);
+    std::remove(outName);
+    return printed.str();
+}
+
+bool testParser() {
+    std::string printed = runScript("A={a,b|<a,b>}\n"
+                                    "print(!!A)\n"
+                                    "print(!(A+{c}))\n"
+                                    "print(((A))-({a}))\n"
+                                    "print(A+{c}-{a}^{b,c})\n"
+                                    "print(A+)\n"
+                                    "print(())\n"
+                                    "print((A)\n"
+                                    "print(!)\n");
+    ASSERT_TEST(printed == "a\nb\n$\na b\n"
+                           "a\nb\nc\n$\na c\nb a\nb c\nc a\nc b\n"
+                           "b\n$\n"
+                           "b\nc\n$\n"
+                           "Error: 'A+' is not a valid expression.\n"
+                           "Error: '()' is not a valid expression.\n"
+                           "Error: '(A' is not a valid expression.\n"
+                           "Error: '!' is not a valid expression.\n");
+    // Functions added after the first version of the language are only keywords where they are called
+    printed = runScript("in={a,b|<a,b>}\n"
+                        "out=in\n"
+                        "import={x}\n"
+                        "threads=import+out\n"
+                        "out(threads,a)\n"
+                        "in(in,b)\n"
+                        "load={a}\n"
+                        "print={a}\n");
+    ASSERT_TEST(printed == "b\na\n"
+                           "Error: 'load' is not a valid variable name.\n"
+                           "Error: 'print' is not a valid variable name.\n");
+    // Plans count the graphs of their literals, which the session keeps no more than PLAN_CACHE_BYTES of
+    Expression::Ptr literal = Expression::compile("{a,b|<a,b>}"), chain = Expression::compile("A+{a,b|<a,b>}");
+    ASSERT_TEST(literal->bytes() > literal->literal->bytes());
+    ASSERT_TEST(chain->bytes() > literal->bytes() && chain->bytes() < 2 * literal->bytes());
+    return true;
+}
+
+bool testSimplify() {
+    // !!A is A itself
+    Expression::Ptr plan = Expression::compile("!!A");
+    ASSERT_TEST(Expression::simplify(plan) == plan->operands[0]->operands[0]);
+    plan = Expression::compile("!!!A");
+    Expression::Ptr simplified = Expression::simplify(plan);
+    ASSERT_TEST(simplified->type == Expression::COMPLEMENT);
+    ASSERT_TEST(simplified->operands[0] == plan->operands[0]->operands[0]->operands[0]);
+    // Left operands are flattened into the chain they start
+    plan = Expression::simplify(Expression::compile("((A+B)-C)^D"));
+    ASSERT_TEST(plan->type == Expression::CHAIN && plan->operators == "+-^" && plan->operands.size() == 4);
+    plan = Expression::simplify(Expression::compile("A+(B-C)"));
+    ASSERT_TEST(plan->operators == "+" && plan->operands[1]->type == Expression::CHAIN);
+    // What '-' removed cannot come back through '^', even across a run of '-' and '^'
+    for(const char* text : {"A-B^B", "(A-B)^B", "A-B-C^D^B", "A+C-B^C^B", "(!!A-B)^B"}) {
+        plan = Expression::simplify(Expression::compile(text));
+        ASSERT_TEST(plan->type == Expression::LITERAL && plan->text == "{}" && plan->literal->getNodes().empty());
+    }
+    plan = Expression::simplify(Expression::compile("A-B^B+C"));
+    ASSERT_TEST(plan->operators == "+" && plan->operands[0]->text == "{}" && plan->operands[1]->text == "C");
+    // '+' can bring the nodes back
+    plan = Expression::simplify(Expression::compile("A-B+C^B"));
+    ASSERT_TEST(plan->operators == "-+^");
+    // Repeated operands are dropped from a leading run of '^' or '+', and only there
+    plan = Expression::simplify(Expression::compile("A^A"));
+    ASSERT_TEST(plan->type == Expression::VARIABLE && plan->text == "A");
+    plan = Expression::simplify(Expression::compile("A+B+A+B-C+A"));
+    ASSERT_TEST(plan->operators == "+-+" && plan->operands[1]->text == "B" && plan->operands[3]->text == "A");
+    plan = Expression::simplify(Expression::compile("B^A^(A)^B+A"));
+    ASSERT_TEST(plan->operators == "^+" && plan->operands[1]->text == "A" && plan->operands[2]->text == "A");
+    plan = Expression::simplify(Expression::compile("A-B-B"));
+    ASSERT_TEST(plan->operators == "--");
+    plan = Expression::simplify(Expression::compile("{a}+{a}"));
+    ASSERT_TEST(plan->type == Expression::LITERAL && plan->text == "{a}");
+    return true;
+}
+
+bool testLazy() {
+    // Lazy variables keep what the variables they read held when they were assigned
+    std::string printed = runScript("lazy(on)\n"
+                                    "A={a,b|<a,b>}\n"
+                                    "B=!A\n"
+                                    "A={c}\n"
+                                    "print(B)\n"
+                                    "C=A+B\n"
+                                    "A+={d}\n"
+                                    "print(C)\n"
+                                    "print(A)\n"
+                                    "D=!!C-A^A\n"
+                                    "print(D)\n"
+                                    "E=A^A+C+A\n"
+                                    "print(E)\n"
+                                    "B=A\n"
+                                    "A=B-{c}\n"
+                                    "print(A)\n"
+                                    "print(B)\n");
+    ASSERT_TEST(printed == "a\nb\n$\nb a\n"
+                           "a\nb\nc\n$\nb a\n"
+                           "c\nd\n$\n"
+                           "$\n"
+                           "a\nb\nc\nd\n$\nb a\n"
+                           "d\n$\n"
+                           "c\nd\n$\n");
+    // Turning it off evaluates the variables that are still pending
+    printed = runScript("lazy(on)\n"
+                        "A={a,b|<a,b>}\n"
+                        "C=A+{c}\n"
+                        "F=C-A\n"
+                        "stats\n"
+                        "lazy(off)\n"
+                        "stats\n"
+                        "F+={e}\n"
+                        "print(F)\n"
+                        "print(C)\n");
+    size_t off = printed.find("statements: 5");
+    ASSERT_TEST(off != std::string::npos);
+    ASSERT_TEST(printed.find("  F: 0 bytes") < off && printed.find("  C: 0 bytes") < off);
+    ASSERT_TEST(printed.find("  F: 0 bytes", off) == std::string::npos);
+    ASSERT_TEST(printed.find("  C: 0 bytes", off) == std::string::npos);
+    ASSERT_TEST(printed.substr(printed.rfind("bytes\n") + 6) == "c\ne\n$\na\nb\nc\n$\na b\n");
+    return true;
+}
+
+bool testSharedValues() {
+    // Assigning a variable to another shares its graph, and changing either copies it first
+    std::string printed = runScript("A={a,b|<a,b>}\n"
+                                    "B=A\n"
+                                    "A+={c}\n"
+                                    "print(B)\n"
+                                    "delete(A)\n"
+                                    "C=B\n"
+                                    "D=C\n"
+                                    "B-={a}\n"
+                                    "print(C)\n"
+                                    "print(B)\n"
+                                    "print(D)\n"
+                                    "stats\n");
+    ASSERT_TEST(printed.compare(0, 34, "a\nb\n$\na b\na\nb\n$\na b\nb\n$\na\nb\n$\na b\n") == 0);
+    ASSERT_TEST(printed.find("copies: 2\n") != std::string::npos);
+    return true;
+}
+
+bool testInPlaceUpdates() {
+    // Only the first operand of G=A+B and the graph H shares are copied, not the results of G's own expression
+    std::string printed = runScript("A={a,b|<a,b>}\n"
+                                    "G=A+{c}\n"
+                                    "G+={d}\n"
+                                    "G-={a}\n"
+                                    "print(G)\n"
+                                    "H=G\n"
+                                    "G+={e}\n"
+                                    "print(H)\n"
+                                    "print(A+{c})\n"
+                                    "stats\n");
+    ASSERT_TEST(printed.substr(0, printed.find("statements:")) == "b\nc\nd\n$\nb\nc\nd\n$\na\nb\nc\n$\na b\n");
+    ASSERT_TEST(printed.find("copies: 3\n") != std::string::npos);
+    // A cached result is compacted like one that isn't, so B takes no more memory than C
+    printed = runScript("A={a,b,c|<a,b>,<b,c>}\n"
+                        "save(A,compact_a.gc)\n"
+                        "B=A+{d}-{a}\n"
+                        "C=load(compact_a.gc)+{d}-{a}\n"
+                        "stats\n");
+    std::remove("compact_a.gc");
+    size_t b = printed.find("\n  B: "), c = printed.find("\n  C: ");
+    ASSERT_TEST(b != std::string::npos && c != std::string::npos);
+    ASSERT_TEST(printed.compare(b + 6, printed.find('\n', b + 1) - b - 6, printed, c + 6,
+                                printed.find('\n', c + 1) - c - 6) == 0);
+    return true;
+}
+
+bool testBatch() {
+    // Large enough that building the literal sorts its edges on several threads
+    std::string literal = "{";
+    for(int i = 0; i < 600; i++) {
+        literal += (i == 0 ? "n" : ",n") + std::to_string(i);
+    }
+    literal += "|";
+    for(int i = 0; i < 600; i++) {
+        for(int j = i % 2; j < 600; j += 2) {
+            if(i != j) {
+                literal += "<n" + std::to_string(i) + ",n" + std::to_string(j) + ">,";
+            }
+        }
+    }
+    literal.back() = '}';
+    std::string script = "A={a,b|<a,b>}\n"
+                         "B={b,c,n1|<b,c>,<c,n1>}\n"
+                         "C=A+B\n"
+                         "print(C)\n"
+                         "D=" + literal + "\n"
+                         "A=A*B\n"
+                         "print(A^C)\n"
+                         "E=D^B\n"
+                         "B-=A\n"
+                         "print(B)\n"
+                         "save(C,batch_graph.gc)\n"
+                         "F=load(batch_graph.gc)+E\n"
+                         "print(F)\n"
+                         "delete(C)\n"
+                         "print(C)\n"
+                         "out(D-{n0},n1)\n"
+                         "C=A\n"
+                         "print(C^A)\n";
+    // More plans than the session keeps, so the literal is compiled again while these statements are queued
+    for(int i = 0; i < 4200; i++) {
+        script += "V" + std::to_string(i) + "={x" + std::to_string(i) + "}+A\n";
+    }
+    script += "who\n";
+    std::string serial = runScript(script, 1);
+    ASSERT_TEST(serial.find("Error: 'C' is undefined.") != std::string::npos);
+    for(int round = 0; round < 5; round++) {
+        ASSERT_TEST(runScript(script, 4) == serial);
+    }
+    std::remove("batch_graph.gc");
+    return true;
+}
+
+bool testJournal() {
+    // A checkpoint and a restore start the journal over, so replaying it doesn't need what came before them
+    runScript("journal(test_journal.txt)\n"
+              "A={a,b|<a,b>}\n"
+              "checkpoint(test_workspace.gc)\n"
+              "B=A+{c}\n"
+              "print(B)\n"
+              "restore(test_workspace.gc)\n"
+              "C=A+{d}\n"
+              "delete(A)\n"
+              "who\n");
+    std::stringstream journal;
+    journal << std::ifstream("test_journal.txt").rdbuf();
+    ASSERT_TEST(journal.str() == "restore(test_workspace.gc)\nC=A+{d}\ndelete(A)\n");
+    // Restoring with the open journal replays it first, then writes it again from the restore
+    std::string printed = runScript("journal(test_journal.txt)\n"
+                                    "restore(test_workspace.gc,test_journal.txt)\n"
+                                    "D=C\n"
+                                    "who\n");
+    journal.str("");
+    journal << std::ifstream("test_journal.txt").rdbuf();
+    ASSERT_TEST(journal.str() == "restore(test_workspace.gc)\nrestore(test_workspace.gc)\nC=A+{d}\ndelete(A)\nD=C\n");
+    ASSERT_TEST(printed == "C\nD\n" && runScript("restore(test_workspace.gc,test_journal.txt)\nwho\n") == printed);
+    std::remove("test_journal.txt");
+    std::remove("test_workspace.gc");
+    return true;
+}
+
+bool testOperandErrors() {
+    // Operands after the one that fails are not evaluated, even the ones that could have run as tasks
+    std::string script = "A={a,b|<a,b>}\n"
+                         "save(A,operand_a.gc)\n"
+                         "save(A+{c},operand_c.gc)\n"
+                         "X=(A+{c})+load(operand_a.gc)+B+load(operand_c.gc)\n"
+                         "print(X)\n"
+                         "cache\n"
+                         "X=A+load(operand_a.gc)+{a,+load(operand_c.gc)\n"
+                         "cache\n";
+    std::string serial = runScript(script, 1);
+    ASSERT_TEST(serial.find("Error: 'B' is undefined.\nError: 'X' is undefined.\n") == 0);
+    ASSERT_TEST(serial.find("file hits: 0, misses: 1, files: 1\nError: '{a,' is not a valid expression.\n") !=
+                std::string::npos);
+    ASSERT_TEST(serial.find("file hits: 1, misses: 1, files: 1\n") != std::string::npos);
+    for(int round = 0; round < 5; round++) {
+        // Batches read the files they load ahead, so none are left from the last round
+        std::remove("operand_a.gc");
+        std::remove("operand_c.gc");
+        ASSERT_TEST(runScript(script, 4) == serial);
+    }
+    // A file that can't be read fails the statement the same way
+    std::string printed = runScript("A={a}\n"
+                                    "X=A+load(operand_a.gc)+load(operand_missing.gc)+load(operand_c.gc)+A\n"
+                                    "print(X)\n", 4);
+    ASSERT_TEST(printed == "Error: Could not open 'operand_missing.gc'.\nError: 'X' is undefined.\n");
+    std::remove("operand_a.gc");
+    std::remove("operand_c.gc");
+    return true;
+}
+
+bool testFileCache() {
+    const char* fname = "cache_graph.gc";
+    Graph g1, g2;
+    g1.addNode("a");
+    g2.addNodes({"b", "c"});
+    g2.addEdge("b", "c");
+    g1.save(fname);
+    FileCache files;
+    SharedGraph loaded = files.load(fname);
+    ASSERT_TEST(loaded->containsNode("a") && files.load(fname) == loaded);
+    ASSERT_TEST(files.hits() == 1 && files.misses() == 1 && files.size() == 1);
+    // A file that is saved over is read again, and the graphs loaded before keep what the file held
+    g2.save(fname);
+    SharedGraph reloaded = files.load(fname);
+    ASSERT_TEST(reloaded != loaded && reloaded->containsNode("c") && reloaded->edgeCount() == 1);
+    ASSERT_TEST(!reloaded->containsNode("a"));
+    ASSERT_TEST(loaded->containsNode("a") && files.misses() == 2 && files.size() == 1);
+    // A load takes the graph the prefetch read
+    g1.save(fname);
+    files.prefetch(fname);
+    SharedGraph prefetched = files.load(fname);
+    ASSERT_TEST(prefetched->containsNode("a") && !prefetched->containsNode("b"));
+    ASSERT_TEST(files.hits() == 2 && files.misses() == 2 && files.load(fname) == prefetched);
+    // Missing files aren't prefetched, and they are tried again once they exist
+    std::remove(fname);
+    files.prefetch(fname);
+    try {
+        files.load(fname);
+        ASSERT_TEST(false);
+    } catch(std::ios_base::failure&) {}
+    ASSERT_TEST(files.misses() == 3);
+    g2.save(fname);
+    ASSERT_TEST(files.load(fname)->containsNode("b") && files.misses() == 4);
+    std::remove(fname);
+
+    // Through load() in a script, where a batch prefetches the files it loads before it runs
+    g1.save(fname);
+    std::string script = "B=load(cache_graph.gc)\n"
+                         "A={b,c|<b,c>}\n"
+                         "save(A,cache_graph.gc)\n"
+                         "C=load(cache_graph.gc)\n"
+                         "D=load(cache_graph.gc)+B\n"
+                         "print(B)\n"
+                         "print(C)\n"
+                         "print(D)\n";
+    for(unsigned threads : {1u, 4u}) {
+        g1.save(fname);
+        ASSERT_TEST(runScript(script, threads) == "a\n$\n"
+                                                  "b\nc\n$\nb c\n"
+                                                  "a\nb\nc\n$\nb c\n");
+    }
+    std::remove(fname);
+    return true;
+}
+
 int main() {
     // RUN_TEST(testEdge);
     RUN_TEST(testCtorAssignment);
     RUN_TEST(testAddRemoveNode);
     RUN_TEST(testAddRemoveEdge);
+    RUN_TEST(testPredecessors);
+    RUN_TEST(testRenumber);
+    RUN_TEST(testOperators);
+    RUN_TEST(testInPlaceOperators);
+    RUN_TEST(testSaveLoad);
+    RUN_TEST(testCorruptFile);
+    RUN_TEST(testArchive);
+    RUN_TEST(testSaveLoadAll);
+    RUN_TEST(testImport);
+    RUN_TEST(testProductNames);
+    RUN_TEST(testKeySet);
+    RUN_TEST(testBuild);
+    RUN_TEST(testBulk);
+    RUN_TEST(testWriteFormats);
+    RUN_TEST(testOperatorRuns);
+    RUN_TEST(testDenseOperators);
+    RUN_TEST(testParallelOperators);
+    RUN_TEST(testVersionedGraph);
+    RUN_TEST(testResultCache);
+    RUN_TEST(testStats);
+    RUN_TEST(testParser);
+    RUN_TEST(testSimplify);
+    RUN_TEST(testLazy);
+    RUN_TEST(testSharedValues);
+    RUN_TEST(testInPlaceUpdates);
+    RUN_TEST(testBatch);
+    RUN_TEST(testJournal);
+    RUN_TEST(testOperandErrors);
+    RUN_TEST(testFileCache);
     return 0;
 }